@@ -0,0 +1,69 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#define M_PI 3.1415926535897932384626433832795
+#define MIN_COVERAGE 0.25 //Share of a pixel a splat never fades below in cull.comp, so the annulus matches the splats it replaces
+
+#include "aggregate.glsl"
+
+// Binding 1 : One per ring or belt
+layout(std430, binding = 1) readonly buffer Aggregates
+{
+	Aggregate aggregates[ ];
+};
+
+// Binding 2 : Members counted into each radial then angular bin by aggregate.comp
+layout(std430, binding = 2) readonly buffer Density
+{
+	uint density[ ];
+};
+
+layout (binding = 5) uniform sampler2DArray samplerArray;
+
+layout(location = 0) in vec2 fragPlaneIn;
+layout(location = 1) in vec3 fragWorldIn;
+layout(location = 2) flat in uint fragAggregateIn;
+
+layout(location = 0) out vec4 outColor;
+
+// Members per unit area in a bin, radially clamped and wrapped around the ring
+float BinDensity(Aggregate aggregate, int radial, int angular)
+{
+	radial = clamp(radial, 0, AGGREGATE_RADIAL_BINS - 1);
+	angular = (angular + AGGREGATE_ANGULAR_BINS) % AGGREGATE_ANGULAR_BINS;
+	float width = (aggregate.outer - aggregate.inner) / float(AGGREGATE_RADIAL_BINS);
+	float innerEdge = aggregate.inner + float(radial) * width;
+	float area = M_PI * ((innerEdge + width) * (innerEdge + width) - innerEdge * innerEdge) / float(AGGREGATE_ANGULAR_BINS);
+	return float(density[fragAggregateIn * AGGREGATE_BINS + uint(radial * AGGREGATE_ANGULAR_BINS + angular)]) / area;
+}
+
+void main() {
+
+	//World area under this pixel, before anything is discarded
+	float pixelArea = length(cross(dFdx(fragWorldIn), dFdy(fragWorldIn)));
+
+	Aggregate aggregate = aggregates[fragAggregateIn];
+	float rho = length(fragPlaneIn);
+	if (rho < aggregate.inner || rho > aggregate.outer)
+		discard;
+
+	//Bilinear between the bin centres
+	float theta = atan(fragPlaneIn.y, fragPlaneIn.x);
+	vec2 bin = vec2((rho - aggregate.inner) / (aggregate.outer - aggregate.inner) * float(AGGREGATE_RADIAL_BINS), fract(theta / (2.0 * M_PI)) * float(AGGREGATE_ANGULAR_BINS)) - 0.5;
+	ivec2 first = ivec2(floor(bin));
+	vec2 weight = bin - vec2(first);
+	float members = mix(
+		mix(BinDensity(aggregate, first.x, first.y), BinDensity(aggregate, first.x + 1, first.y), weight.x),
+		mix(BinDensity(aggregate, first.x, first.y + 1), BinDensity(aggregate, first.x + 1, first.y + 1), weight.x),
+		weight.y);
+
+	//Each member hides its own cross section, or as much of the pixel as its splat would when that is more
+	float coverage = members * max(aggregate.memberArea, MIN_COVERAGE * pixelArea);
+
+	//The smallest mip is the texture's average colour
+	vec3 colour = aggregate.colour.xyz;
+	if (aggregate.colour.w >= 0.0)
+		colour *= textureLod(samplerArray, vec3(0.5, 0.5, aggregate.colour.w), 16.0).rgb;
+	outColor = vec4(colour, (1.0 - exp(-coverage)) * aggregate.centre.w);
+}
@@ -0,0 +1,36 @@
+// Rings and belts drawn as a density annulus from a distance, shared by aggregate.comp, its draw and cull.comp
+
+#define AGGREGATE_RADIAL_BINS 32
+#define AGGREGATE_ANGULAR_BINS 256
+#define AGGREGATE_BINS (AGGREGATE_RADIAL_BINS * AGGREGATE_ANGULAR_BINS) //Must match OrreyVk.cpp
+#define AGGREGATE_SEGMENTS 128 //Quads around the annulus, must match OrreyVk.cpp
+
+struct Aggregate
+{
+  uint first; //Instance buffer index of the first member
+  uint count;
+  float inner;
+  float outer;
+  vec4 colour; //rgb Average member tint, w texture layer
+  vec4 centre; //xyz Where the body the members orbit is this frame, w how far they have faded into the annulus. Written by aggregate.comp
+  vec4 tilt; //Orbital tilt every member shares
+  float memberSize; //Largest member scale, the fade is judged by it
+  float memberArea; //Average member cross section
+  uint pad0;
+  uint pad1;
+};
+
+// PCG style integer hash, 0 to 1
+float Hash(uint value)
+{
+  uint hash = value * 747796405u + 2891336453u;
+  hash = ((hash >> ((hash >> 28u) + 4u)) ^ hash) * 277803737u;
+  hash = (hash >> 22u) ^ hash;
+  return float(hash) * (1.0 / 4294967296.0);
+}
+
+// Whether a member has handed over to the annulus, the same ones go first every frame so the cross fade does not flicker
+bool Dissolved(uint index, float fade)
+{
+  return Hash(index) < fade;
+}
@@ -0,0 +1,54 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+#define M_PI 3.1415926535897932384626433832795
+
+#include "transform.glsl"
+#include "aggregate.glsl"
+#include "views.glsl"
+
+// Binding 1 : One per ring or belt, an instance each
+layout(std430, binding = 1) readonly buffer Aggregates
+{
+	Aggregate aggregates[ ];
+};
+
+layout (binding = 3) uniform UBO
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	mat4 viewProjection;
+	View views[MAX_VIEWS]; //gl_ViewIndex picks this view's
+} ubo;
+
+layout(location = 0) out vec2 fragPlaneOut; //About the centre, in the plane of the members' orbits
+layout(location = 1) out vec3 fragWorldOut;
+layout(location = 2) flat out uint fragAggregateOut;
+
+//Two triangles per segment, x around the annulus and y from its inner edge to its outer one
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+
+	//Nothing is drawn while every member is still drawn itself
+	Aggregate aggregate = aggregates[gl_InstanceIndex];
+	if (aggregate.centre.w <= 0.0)
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
+	//The outer edge is pushed out so its chords still cover the circle, the fragment shader trims both edges back to round
+	vec2 corner = corners[gl_VertexIndex % 6];
+	float theta = (float(gl_VertexIndex / 6) + corner.x) * 2.0 * M_PI / float(AGGREGATE_SEGMENTS);
+	float rho = corner.y == 0.0 ? aggregate.inner : aggregate.outer / cos(M_PI / float(AGGREGATE_SEGMENTS));
+	vec2 plane = rho * vec2(cos(theta), sin(theta));
+	vec3 world = WorldPosition(vec3(plane.x, 0.0, plane.y), aggregate.centre, aggregate.tilt);
+
+	fragPlaneOut = plane;
+	fragWorldOut = world;
+	fragAggregateOut = uint(gl_InstanceIndex);
+	gl_Position = ubo.views[gl_ViewIndex].viewProjection * vec4(world, 1.0);
+}
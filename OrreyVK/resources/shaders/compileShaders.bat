@@ -1,9 +1,34 @@
 glslangvalidator -V orbit.vert -o orbit.vert.spv --target-env vulkan1.1
 glslangvalidator -V orbit.frag -o orbit.frag.spv --target-env vulkan1.1
+glslangvalidator -V orbit.comp -o orbit.comp.spv --target-env vulkan1.1
 
 glslangvalidator -V planets.vert -o planets.vert.spv --target-env vulkan1.1
+glslangvalidator -V planets.vert -DVISIBILITY -o planets_vis.vert.spv --target-env vulkan1.1
 glslangvalidator -V planets.comp -o planets.comp.spv --target-env vulkan1.1
+glslangvalidator -V cull.comp -o cull.comp.spv --target-env vulkan1.1
+glslangvalidator -V cull.comp -DSPLAT -o cull_splat.comp.spv --target-env vulkan1.1
+glslangvalidator -V hiz.comp -o hiz.comp.spv --target-env vulkan1.1
+glslangvalidator -V hiz.comp -DMULTISAMPLED -o hiz_ms.comp.spv --target-env vulkan1.1
+glslangvalidator -V fxaa.comp -o fxaa.comp.spv --target-env vulkan1.1
+glslangvalidator -V taa.comp -o taa.comp.spv --target-env vulkan1.1
+glslangvalidator -V diagnostics.comp -o diagnostics.comp.spv --target-env vulkan1.1
+glslangvalidator -V keyframe.comp -o keyframe.comp.spv --target-env vulkan1.1
+glslangvalidator -V record.comp -o record.comp.spv --target-env vulkan1.1
+glslangvalidator -V populate.comp -o populate.comp.spv --target-env vulkan1.1
+glslangvalidator -V preview.comp -o preview.comp.spv --target-env vulkan1.1
+glslangvalidator -V aggregate.comp -o aggregate.comp.spv --target-env vulkan1.1
+glslangvalidator -V sky.comp -o sky.comp.spv --target-env vulkan1.1
 glslangvalidator -V planets.frag -o planets.frag.spv --target-env vulkan1.1
+glslangvalidator -V impostor.vert -o impostor.vert.spv --target-env vulkan1.1
+glslangvalidator -V impostor.frag -o impostor.frag.spv --target-env vulkan1.1
+glslangvalidator -V impostor.vert -DVISIBILITY -o impostor_vis.vert.spv --target-env vulkan1.1
+glslangvalidator -V impostor.frag -DVISIBILITY -o impostor_vis.frag.spv --target-env vulkan1.1
+glslangvalidator -V visibility.frag -o visibility.frag.spv --target-env vulkan1.1
+glslangvalidator -V visibility_shade.frag -o visibility_shade.frag.spv --target-env vulkan1.1
+glslangvalidator -V composite.vert -o composite.vert.spv --target-env vulkan1.1
+glslangvalidator -V composite.frag -o composite.frag.spv --target-env vulkan1.1
+glslangvalidator -V aggregate.vert -o aggregate.vert.spv --target-env vulkan1.1
+glslangvalidator -V aggregate.frag -o aggregate.frag.spv --target-env vulkan1.1
 
-glslangvalidator -V skysphere.vert -o skysphere.vert.spv --target-env vulkan1.1
-glslangvalidator -V skysphere.frag -o skysphere.frag.spv --target-env vulkan1.1
\ No newline at end of file
+glslangvalidator -V sky.vert -o sky.vert.spv --target-env vulkan1.1
+glslangvalidator -V sky.frag -o sky.frag.spv --target-env vulkan1.1
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Binding 0 : Splats written by cull.comp, read as two halves so no 64 bit support is needed here. x is the colour and y the depth
+layout(std430, binding = 0) readonly buffer Splats
+{
+	uvec2 splats[ ];
+};
+
+layout (push_constant) uniform Push
+{
+	uint viewportWidth;
+} push;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+
+	uvec2 splat = splats[uint(gl_FragCoord.y) * push.viewportWidth + uint(gl_FragCoord.x)];
+	if (splat.y == 0xFFFFFFFFu)
+		discard;
+
+	//Depth tested like any other fragment so meshes in front still hide the splat
+	gl_FragDepth = uintBitsToFloat(splat.y);
+	outColor = unpackUnorm4x8(splat.x);
+}
@@ -0,0 +1,80 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+//Built a second time with VISIBILITY defined, writing the object's id for visibility_shade.frag instead of shading it
+
+#define M_PI 3.1415926535897932384626433832795
+
+layout (binding = 3) uniform sampler2DArray samplerArray;
+
+#ifdef VISIBILITY
+#include "visibility.glsl"
+
+layout(location = 0) out uvec2 outVisibility;
+layout(location = 6) flat in uint fragObjectIn;
+#else
+layout(location = 0) out vec4 outColor;
+#endif
+
+layout(location = 0) flat in vec3 rayOrigin;
+layout(location = 1) in vec3 rayDirection;
+layout(location = 2) flat in vec4 clipOrigin;
+layout(location = 3) in vec4 clipDirection;
+layout(location = 4) flat in vec3 fragColourIn;
+layout(location = 5) flat in float fragLayerIn;
+
+void main() {
+
+    //Nearest hit of the ray on the sphere mesh's radius 0.5 sphere
+    float a = dot(rayDirection, rayDirection);
+    float b = dot(rayOrigin, rayDirection);
+    float c = dot(rayOrigin, rayOrigin) - 0.25;
+    float discriminant = b * b - a * c;
+    float t = (-b - sqrt(max(discriminant, 0.0))) / a;
+    vec3 hit = rayOrigin + t * rayDirection;
+
+#ifdef VISIBILITY
+    if (discriminant < 0.0)
+        discard;
+
+    vec4 clip = clipOrigin + t * clipDirection;
+    gl_FragDepth = clip.z / clip.w;
+
+    outVisibility = PackVisibility(fragObjectIn, VISIBILITY_IMPOSTOR, 0u);
+#else
+    //The UVs SolidSphere gives the vertex at this point
+    float theta = atan(hit.z, hit.x);
+    if (theta < 0.0)
+        theta += 2.0 * M_PI;
+    float phi = acos(clamp(hit.y / 0.5, -1.0, 1.0));
+    vec2 uv = vec2(1.0 - theta / (2.0 * M_PI), 1.0 - phi / M_PI);
+
+    //Gradients from whichever of u and u shifted by half a turn is continuous here, so the seam does not drop to the smallest mip
+    vec2 wrapped = vec2(fract(uv.x + 0.5), uv.y);
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    vec2 dxWrapped = dFdx(wrapped);
+    vec2 dyWrapped = dFdy(wrapped);
+    if (abs(dxWrapped.x) + abs(dyWrapped.x) < abs(dx.x) + abs(dy.x))
+    {
+        dx = dxWrapped;
+        dy = dyWrapped;
+    }
+
+    if (discriminant < 0.0)
+        discard;
+
+    vec4 clip = clipOrigin + t * clipDirection;
+    gl_FragDepth = clip.z / clip.w;
+
+    outColor = textureGrad(samplerArray, vec3(uv, fragLayerIn), dx, dy);
+    outColor.xyz *= fragColourIn;
+
+    if(fragLayerIn < 0.0)
+    {
+        outColor.xyz = fragColourIn;
+        outColor.w = 1.0;
+    }
+#endif
+}
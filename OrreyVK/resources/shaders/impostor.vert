@@ -0,0 +1,81 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+// Corners of the impostor quad, -1 to 1 in x and y
+layout(location = 0) in vec3 vtxPosIn;
+
+#include "transform.glsl"
+#include "views.glsl"
+
+// Binding 0 : Render stream, placed and packed by cull.comp
+layout(std430, binding = 0) readonly buffer Instances
+{
+	RenderInstance instances[ ];
+};
+
+// Binding 1 : Objects that survived cull.comp, one per instance
+layout(std430, binding = 1) readonly buffer Visible
+{
+	uint visible[ ];
+};
+
+layout (binding = 2) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	mat4 viewProjection;
+	View views[MAX_VIEWS]; //gl_ViewIndex picks this view's
+} ubo;
+
+//The ray from the camera through this corner, in the sphere mesh's own space where the body is a sphere of radius 0.5
+layout(location = 0) flat out vec3 rayOrigin;
+layout(location = 1) out vec3 rayDirection;
+//The same ray in clip space, for the depth of the hit
+layout(location = 2) flat out vec4 clipOrigin;
+layout(location = 3) out vec4 clipDirection;
+layout(location = 4) flat out vec3 fragColourIn;
+layout(location = 5) flat out float fragLayerIn;
+#ifdef VISIBILITY
+layout(location = 6) flat out uint fragObjectIn;
+#endif
+
+void main() {
+
+	RenderInstance instance = instances[visible[gl_InstanceIndex]];
+
+	mat4 modelView = ubo.views[gl_ViewIndex].view * ubo.model;
+	mat3 viewRotation = mat3(modelView);
+	vec3 cameraPos = -(transpose(viewRotation) * modelView[3].xyz);
+
+	vec3 centre = instance.centre;
+	vec3 scale = GetScale(instance);
+	float radius = 0.5 * max(scale.x, max(scale.y, scale.z)); //The sphere mesh has a radius of 0.5
+
+	//Face the camera and size the quad to the cone of rays that touch the bounding sphere, so the silhouette is never clipped
+	vec3 toCamera = cameraPos - centre;
+	float cameraDistance = length(toCamera);
+	vec3 forward = toCamera / cameraDistance;
+	vec3 right = normalize(cross(vec3(viewRotation[0][1], viewRotation[1][1], viewRotation[2][1]), forward));
+	vec3 up = cross(forward, right);
+	float halfSize = radius * cameraDistance / sqrt(max(cameraDistance * cameraDistance - radius * radius, 1e-12));
+	vec3 corner = centre + (right * vtxPosIn.x + up * vtxPosIn.y) * halfSize;
+
+	//Undo what planets.vert does to a mesh vertex: unscale, then rotate back
+	vec4 inverseRotation = GetRotation(instance) * vec4(-1.0, -1.0, -1.0, 1.0);
+
+	mat4 viewProjection = ubo.views[gl_ViewIndex].viewProjection;
+	rayOrigin = Rotate(inverseRotation, (cameraPos - centre) / scale);
+	rayDirection = Rotate(inverseRotation, (corner - cameraPos) / scale);
+	clipOrigin = viewProjection * vec4(cameraPos, 1.0);
+	clipDirection = viewProjection * vec4(corner - cameraPos, 0.0);
+
+	gl_Position = clipOrigin + clipDirection;
+
+	fragColourIn = GetTint(instance);
+	fragLayerIn = float(GetLayer(instance));
+#ifdef VISIBILITY
+	fragObjectIn = visible[gl_InstanceIndex];
+#endif
+}
@@ -1,16 +1,21 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
 
-layout(location = 0) in vec2 vtxPosIn;
+#include "views.glsl"
+
+layout(location = 0) in vec4 vtxPosIn; //World space, written by orbit.comp
 
 layout (binding = 2) uniform UBO 
 {
 	mat4 projection;
 	mat4 model;
 	mat4 view;
+	mat4 viewProjection;
+	View views[MAX_VIEWS]; //gl_ViewIndex picks this view's
 } ubo;
 
 void main() {
 
-	vec4 pos = vec4(vtxPosIn.x, 0.0, vtxPosIn.y, 1.0);
-	gl_Position = ubo.projection * ubo.view * ubo.model * pos;
+	gl_Position = ubo.views[gl_ViewIndex].viewProjection * vtxPosIn;
 }
\ No newline at end of file
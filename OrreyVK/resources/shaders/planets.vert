@@ -1,70 +1,50 @@
 #version 450
+#extension GL_EXT_multiview : require
 
 layout(location = 0) in vec3 vtxPosIn;
-layout(location = 1) in vec3 vtxColourIn;
-layout(location = 2) in vec3 vtxUVIn;
+layout(location = 2) in vec2 vtxUVIn;
 
-layout(location = 3) in vec4 instancePosIn;
-layout(location = 4) in vec4 posOffset;
-layout(location = 5) in vec4 scale;
-layout(location = 6) in vec4 rotation;
-layout(location = 7) in vec4 orbitalTilt;
-layout(location = 8) in vec4 colourTint;
+#extension GL_GOOGLE_include_directive : require
+
+#include "transform.glsl"
+#include "views.glsl"
+
+// Binding 0 : Render stream, placed and packed by cull.comp
+layout(std430, binding = 0) readonly buffer Instances
+{
+	RenderInstance instances[ ];
+};
+
+// Binding 1 : Objects that survived cull.comp, one per instance
+layout(std430, binding = 1) readonly buffer Visible
+{
+	uint visible[ ];
+};
 
 layout(location = 1) out vec3 fragColourIn;
 layout(location = 2) out vec3 fragUVIn;
+#ifdef VISIBILITY
+layout(location = 0) flat out uint fragObjectIn;
+#endif
 
 layout (binding = 2) uniform UBO 
 {
 	mat4 projection;
 	mat4 model;
 	mat4 view;
+	mat4 viewProjection;
+	View views[MAX_VIEWS]; //gl_ViewIndex picks this view's
 } ubo;
 
-mat3 GetRotationMatrix(vec3 rotation)
-{
-	mat3 matX;
-	float s = sin(rotation.x);
-	float c = cos(rotation.x);
-
-	matX[0] = vec3(c, s, 0.0);
-	matX[1] = vec3(-s, c, 0.0);
-	matX[2] = vec3(0.0, 0.0, 1.0);
-
-	mat3 matY;
-	s = sin(rotation.y);
-	c = cos(rotation.y);
-	
-	matY[0] = vec3(c, 0.0, s);
-	matY[1] = vec3(0.0, 1.0, 0.0);
-	matY[2] = vec3(-s, 0.0, c);
-
-	mat3 matZ;
-	s = sin(rotation.z);
-	c = cos(rotation.z);
-	
-	matZ[0] = vec3(1.0, 0.0, 0.0);
-	matZ[1] = vec3(0.0, c, s);
-	matZ[2] = vec3(0.0, -s, c);
-
-	return matZ * matY * matX; //Perform X rotation before Y
-}
-
 void main() {
 
-	mat3 localRotMat =  GetRotationMatrix(rotation.xyz);
-	mat3 orbitalTiltMat = GetRotationMatrix(orbitalTilt.xyz);
+	RenderInstance instance = instances[visible[gl_InstanceIndex]];
 
-	localRotMat *= orbitalTiltMat;
-		
-	vec4 locPos = vec4(vtxPosIn.xyz * localRotMat, 1.0);
-	vec4 pos = vec4((locPos.xyz * scale.xyz + instancePosIn.xyz), 1.0);
-	pos.xyz *= orbitalTiltMat;
-	pos.xyz += posOffset.xyz;
-	
-	gl_Position = ubo.projection * ubo.view * ubo.model * pos;
+	gl_Position = ubo.views[gl_ViewIndex].viewProjection * vec4(ToWorld(instance, vtxPosIn), 1.0);
     
-	fragColourIn = colourTint.xyz;
-	fragUVIn = vtxUVIn;
-	fragUVIn.z = scale.w;
+	fragColourIn = GetTint(instance);
+	fragUVIn = vec3(vtxUVIn, float(GetLayer(instance)));
+#ifdef VISIBILITY
+	fragObjectIn = visible[gl_InstanceIndex];
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 450
+
+layout (binding = 3) uniform samplerCube starfield;
+
+layout(location = 0) in vec3 fragDirectionIn;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = texture(starfield, fragDirectionIn);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+#include "views.glsl"
+
+layout (binding = 2) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	mat4 viewProjection;
+	View views[MAX_VIEWS]; //gl_ViewIndex picks this view's
+} ubo;
+
+layout(location = 0) out vec3 fragDirectionOut;
+
+//One triangle covering the screen on the far plane, only the pixels nothing else covered pass the depth test
+void main() {
+	vec2 ndc = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+	gl_Position = vec4(ndc, 1.0, 1.0);
+
+	//View ray through each corner, turned into the frame the sky sphere used to be placed in by the model matrix
+	vec3 viewDirection = vec3(ndc.x / ubo.projection[0][0], ndc.y / ubo.projection[1][1], -1.0);
+	fragDirectionOut = transpose(mat3(ubo.views[gl_ViewIndex].view * ubo.model)) * viewDirection;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+// One integration step of an object about the body it orbits, shared by planets.comp and preview.comp
+// pos is relative to that body and scaled by scale, vel is in AU per day and stored negated
+// GravityTowards and Accelerate add the pull of other bodies, only preview.comp uses them
+
+const float G = 0.0002959122083;
+
+void StepOrbit(inout vec4 pos, inout vec4 vel, float stepTime, int scale)
+{
+  vec3 vPos = pos.xyz;
+
+  float xT = (vPos.x / scale);
+  float zT = (vPos.z / scale);
+
+  float xV = vel.x;
+  float zV = vel.z;
+  
+  float radiusSquared = pow(xT, 2) + pow(zT, 2);
+	vec3 forceDir = normalize(vPos);
+
+  vec3 gravAcc = (forceDir * G) / radiusSquared;
+
+  xV += (gravAcc.x * stepTime);
+  zV += (gravAcc.z * stepTime);
+  
+  xT -= xV * stepTime;
+  zT -= zV * stepTime;
+
+  pos.x = xT * scale;
+  pos.z = zT * scale;
+
+  vel.x = xV;
+  vel.z = zV;
+}
+
+
+// Acceleration towards a body of the given mass, both positions are world positions scaled by scale
+vec3 GravityTowards(vec3 pos, vec3 bodyPos, float mass, int scale)
+{
+  vec3 offset = (bodyPos - pos) / scale;
+  float distanceSquared = max(dot(offset, offset), 1e-12);
+  return offset * (G * mass / (distanceSquared * sqrt(distanceSquared)));
+}
+
+// Orbits are integrated in the plane, so only the in plane part of the acceleration is kept
+void Accelerate(inout vec4 vel, vec3 acceleration, float stepTime)
+{
+  vel.x -= acceleration.x * stepTime;
+  vel.z -= acceleration.z * stepTime;
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Placement of an object in world space, shared by the shaders that need it
+
+mat3 GetRotationMatrix(vec3 rotation)
+{
+	mat3 matX;
+	float s = sin(rotation.x);
+	float c = cos(rotation.x);
+
+	matX[0] = vec3(c, s, 0.0);
+	matX[1] = vec3(-s, c, 0.0);
+	matX[2] = vec3(0.0, 0.0, 1.0);
+
+	mat3 matY;
+	s = sin(rotation.y);
+	c = cos(rotation.y);
+
+	matY[0] = vec3(c, 0.0, s);
+	matY[1] = vec3(0.0, 1.0, 0.0);
+	matY[2] = vec3(-s, 0.0, c);
+
+	mat3 matZ;
+	s = sin(rotation.z);
+	c = cos(rotation.z);
+
+	matZ[0] = vec3(1.0, 0.0, 0.0);
+	matZ[1] = vec3(0.0, c, s);
+	matZ[2] = vec3(0.0, -s, c);
+
+	return matZ * matY * matX; //Perform X rotation before Y
+}
+
+// Where planets.vert puts an object's centre, pos is about the body it orbits and tilted with its orbit
+vec3 WorldPosition(vec3 pos, vec4 posOffset, vec4 orbitalTilt)
+{
+  if (orbitalTilt.xyz == vec3(0.0))
+    return pos + posOffset.xyz;
+  return pos * GetRotationMatrix(orbitalTilt.xyz) + posOffset.xyz;
+}
+
+// Render stream entry, written by cull.comp for each object it draws so the vertex shaders need no trig. 32 bytes
+struct RenderInstance
+{
+  vec3 centre;
+  uint tint; //packUnorm4x8 of the colour tint
+  uvec2 rotation; //Unit quaternion as snorm16s, xy then zw
+  uvec2 scaleLayer; //Scale as halves, xy then z with the texture layer above it as a signed 16 bit integer
+};
+
+vec4 ToQuaternion(mat3 m)
+{
+  float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0.0)
+  {
+    float s = 0.5 / sqrt(trace + 1.0);
+    return vec4((m[1][2] - m[2][1]) * s, (m[2][0] - m[0][2]) * s, (m[0][1] - m[1][0]) * s, 0.25 / s);
+  }
+  if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+  {
+    float s = 2.0 * sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]);
+    return vec4(0.25 * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+  }
+  if (m[1][1] > m[2][2])
+  {
+    float s = 2.0 * sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]);
+    return vec4((m[1][0] + m[0][1]) / s, 0.25 * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+  }
+  float s = 2.0 * sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]);
+  return vec4((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25 * s, (m[0][1] - m[1][0]) / s);
+}
+
+vec3 Rotate(vec4 q, vec3 v)
+{
+  vec3 t = 2.0 * cross(q.xyz, v);
+  return v + q.w * t + cross(q.xyz, t);
+}
+
+// Spin and tilt, then tilt into the orbit, scale along the world axes and move about the body being orbited.
+// planets.vert used to scale in the orbit's frame instead, which only differs for stretched bodies on a tilted orbit
+RenderInstance GetRenderInstance(vec3 pos, vec4 scale, vec4 rotation, vec4 posOffset, vec4 orbitalTilt, vec4 colourTint)
+{
+  mat3 orbitalTiltMat = GetRotationMatrix(orbitalTilt.xyz);
+  vec4 q = ToQuaternion(transpose(GetRotationMatrix(rotation.xyz) * orbitalTiltMat * orbitalTiltMat));
+
+  RenderInstance instance;
+  instance.centre = pos * orbitalTiltMat + posOffset.xyz;
+  instance.tint = packUnorm4x8(vec4(colourTint.xyz, 1.0));
+  instance.rotation = uvec2(packSnorm2x16(q.xy), packSnorm2x16(q.zw));
+  instance.scaleLayer = uvec2(packHalf2x16(scale.xy), (packHalf2x16(vec2(scale.z, 0.0)) & 0xFFFFu) | (uint(int(scale.w)) << 16));
+  return instance;
+}
+
+vec4 GetRotation(RenderInstance instance)
+{
+  return normalize(vec4(unpackSnorm2x16(instance.rotation.x), unpackSnorm2x16(instance.rotation.y)));
+}
+
+vec3 GetScale(RenderInstance instance)
+{
+  return vec3(unpackHalf2x16(instance.scaleLayer.x), unpackHalf2x16(instance.scaleLayer.y).x);
+}
+
+int GetLayer(RenderInstance instance)
+{
+  return int(instance.scaleLayer.y) >> 16; //Sign extends
+}
+
+vec3 GetTint(RenderInstance instance)
+{
+  return unpackUnorm4x8(instance.tint).xyz;
+}
+
+vec3 ToWorld(RenderInstance instance, vec3 position)
+{
+  return instance.centre + GetScale(instance) * Rotate(GetRotation(instance), position);
+}
@@ -0,0 +1,9 @@
+// One camera per view drawn in a multiview pass, appended to the graphics UBO
+
+#define MAX_VIEWS 4 //Must match MULTIVIEW_MAX_VIEWS in OrreyVk.cpp
+
+struct View
+{
+  mat4 view; //The camera moved or turned for this view
+  mat4 viewProjection; //projection * view * model
+};
\ No newline at end of file
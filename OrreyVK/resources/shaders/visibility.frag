@@ -0,0 +1,17 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "visibility.glsl"
+
+layout (push_constant) uniform Push
+{
+	uint bucket; //Level of detail being drawn, so the shading pass knows which index range the triangle is in
+} push;
+
+layout(location = 0) flat in uint fragObjectIn;
+
+layout(location = 0) out uvec2 outVisibility;
+
+void main() {
+	outVisibility = PackVisibility(fragObjectIn, push.bucket, uint(gl_PrimitiveID));
+}
@@ -0,0 +1,10 @@
+// Visibility buffer texels, written by planets.vert and impostor.vert built with VISIBILITY and read back by visibility_shade.frag
+
+const uint VISIBILITY_EMPTY = 0xFFFFFFFFu; //x of a texel nothing was drawn to, the clear value
+const uint VISIBILITY_IMPOSTOR = 0xFFu; //Bucket of a ray cast impostor, there is no triangle to fetch
+
+// x is the render stream index, y the level of detail bucket above the triangle within that level
+uvec2 PackVisibility(uint object, uint bucket, uint primitive)
+{
+  return uvec2(object, (bucket << 24) | (primitive & 0xFFFFFFu));
+}
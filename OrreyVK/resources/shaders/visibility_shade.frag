@@ -0,0 +1,172 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#define M_PI 3.1415926535897932384626433832795
+#define LOD_COUNT 4 //Must match SPHERE_LOD_COUNT
+
+#include "transform.glsl"
+#include "visibility.glsl"
+
+// Binding 0 : Render stream, placed and packed by cull.comp
+layout(std430, binding = 0) readonly buffer Instances
+{
+	RenderInstance instances[ ];
+};
+
+// Binding 1 : Object and triangle under each pixel
+layout (binding = 1) uniform usampler2D visibilityImage;
+
+layout (binding = 2) uniform UBO
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	mat4 viewProjection;
+} ubo;
+
+layout (binding = 3) uniform sampler2DArray samplerArray;
+
+// Binding 4 : Sphere vertex buffer, three words a vertex. Position as snorm16 xy then zw, texture coordinates as halves
+layout(std430, binding = 4) readonly buffer Vertices
+{
+	uint vertices[ ];
+};
+
+// Binding 5 : Sphere index buffer, two 16 bit indices a word
+layout(std430, binding = 5) readonly buffer Indices
+{
+	uint indices[ ];
+};
+
+layout (push_constant) uniform Push
+{
+	uvec2 viewport;
+	uvec2 lods[LOD_COUNT]; //firstIndex and vertexOffset of each level of detail
+} push;
+
+layout(location = 0) out vec4 outColor;
+
+uint GetIndex(uint index)
+{
+	return (indices[index >> 1] >> ((index & 1u) * 16u)) & 0xFFFFu;
+}
+
+// Perspective correct barycentrics of a point in normalized device coordinates, and how they change one pixel right and one pixel down
+void Barycentrics(vec4 clip[3], vec2 ndc, vec2 pixelSize, out vec3 lambda, out vec3 lambdaDx, out vec3 lambdaDy)
+{
+	vec3 invW = 1.0 / vec3(clip[0].w, clip[1].w, clip[2].w);
+	vec2 ndc0 = clip[0].xy * invW.x;
+	vec2 ndc1 = clip[1].xy * invW.y;
+	vec2 ndc2 = clip[2].xy * invW.z;
+
+	float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+	vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+	float ddxSum = ddx.x + ddx.y + ddx.z;
+	float ddySum = ddy.x + ddy.y + ddy.z;
+
+	//1/w and lambda/w are linear in screen space
+	vec2 delta = ndc - ndc0;
+	float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+	lambda = vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy;
+	lambda /= interpInvW;
+
+	ddx *= pixelSize.x;
+	ddy *= pixelSize.y;
+	lambdaDx = (lambda * interpInvW + ddx) / (interpInvW + ddxSum * pixelSize.x) - lambda;
+	lambdaDy = (lambda * interpInvW + ddy) / (interpInvW + ddySum * pixelSize.y) - lambda;
+}
+
+// The UVs SolidSphere gives the point a ray first hits on the sphere mesh's radius 0.5 sphere, grazing rays take the closest point
+vec2 SphereUV(vec3 rayOrigin, vec3 rayDirection)
+{
+	float a = dot(rayDirection, rayDirection);
+	float b = dot(rayOrigin, rayDirection);
+	float c = dot(rayOrigin, rayOrigin) - 0.25;
+	float t = (-b - sqrt(max(b * b - a * c, 0.0))) / a;
+	vec3 hit = rayOrigin + t * rayDirection;
+
+	float theta = atan(hit.z, hit.x);
+	if (theta < 0.0)
+		theta += 2.0 * M_PI;
+	float phi = acos(clamp(hit.y / 0.5, -1.0, 1.0));
+	return vec2(1.0 - theta / (2.0 * M_PI), 1.0 - phi / M_PI);
+}
+
+void main() {
+
+	uvec2 id = texelFetch(visibilityImage, ivec2(gl_FragCoord.xy), 0).xy;
+	if (id.x == VISIBILITY_EMPTY)
+		discard;
+
+	RenderInstance instance = instances[id.x];
+	uint bucket = id.y >> 24;
+	vec2 pixelSize = 2.0 / vec2(push.viewport);
+	vec2 ndc = gl_FragCoord.xy * pixelSize - 1.0;
+
+	//Gradients come from the pixel's neighbours on the same surface, never from whatever was drawn next to it
+	vec2 uv;
+	vec2 dx;
+	vec2 dy;
+	if (bucket == VISIBILITY_IMPOSTOR)
+	{
+		//Ray cast again as impostor.frag did, for this pixel and the ones right of and below it
+		mat4 modelView = ubo.view * ubo.model;
+		mat3 viewRotation = mat3(modelView);
+		vec3 cameraPos = -(transpose(viewRotation) * modelView[3].xyz);
+		vec3 scale = GetScale(instance);
+		vec4 inverseRotation = GetRotation(instance) * vec4(-1.0, -1.0, -1.0, 1.0);
+		vec3 rayOrigin = Rotate(inverseRotation, (cameraPos - instance.centre) / scale);
+
+		vec2 rays[3] = vec2[](ndc, ndc + vec2(pixelSize.x, 0.0), ndc + vec2(0.0, pixelSize.y));
+		vec2 uvs[3];
+		for (int i = 0; i < 3; i++)
+		{
+			vec3 viewDirection = vec3(rays[i].x / ubo.projection[0][0], rays[i].y / ubo.projection[1][1], -1.0);
+			uvs[i] = SphereUV(rayOrigin, Rotate(inverseRotation, transpose(viewRotation) * viewDirection / scale));
+		}
+		uv = uvs[0];
+		dx = uvs[1] - uv;
+		dy = uvs[2] - uv;
+
+		//Across the seam u jumps by a whole turn
+		dx.x -= round(dx.x);
+		dy.x -= round(dy.x);
+	}
+	else
+	{
+		//Fetch the triangle back and transform it as planets.vert did
+		uvec2 lod = push.lods[bucket];
+		uint firstIndex = lod.x + (id.y & 0xFFFFFFu) * 3u;
+		vec4 clip[3];
+		vec2 uvs[3];
+		for (uint i = 0u; i < 3u; i++)
+		{
+			uint vertex = (lod.y + GetIndex(firstIndex + i)) * 3u;
+			vec3 position = vec3(unpackSnorm2x16(vertices[vertex]), unpackSnorm2x16(vertices[vertex + 1u]).x);
+			clip[i] = ubo.viewProjection * vec4(ToWorld(instance, position), 1.0);
+			uvs[i] = unpackHalf2x16(vertices[vertex + 2u]);
+		}
+
+		vec3 lambda;
+		vec3 lambdaDx;
+		vec3 lambdaDy;
+		Barycentrics(clip, ndc, pixelSize, lambda, lambdaDx, lambdaDy);
+		mat3x2 triangleUVs = mat3x2(uvs[0], uvs[1], uvs[2]);
+		uv = triangleUVs * lambda;
+		dx = triangleUVs * lambdaDx;
+		dy = triangleUVs * lambdaDy;
+	}
+
+	vec3 tint = GetTint(instance);
+	float layer = float(GetLayer(instance));
+	outColor = textureGrad(samplerArray, vec3(uv, layer), dx, dy);
+	outColor.xyz *= tint;
+
+	if (layer < 0.0)
+	{
+		outColor.xyz = tint;
+		outColor.w = 1.0;
+	}
+}
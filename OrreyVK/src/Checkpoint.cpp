@@ -0,0 +1,169 @@
+#include "Checkpoint.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sim {
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			fileHandle = nullptr;
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			Close();
+			return false;
+		}
+		data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		fileDescriptor = open(path.c_str(), O_RDONLY);
+		if (fileDescriptor < 0)
+			return false;
+
+		struct stat fileStat;
+		fstat(fileDescriptor, &fileStat);
+		size = static_cast<size_t>(fileStat.st_size);
+
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		data = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+#endif
+		if (data == nullptr)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mappingHandle)
+			CloseHandle(mappingHandle);
+		if (fileHandle)
+			CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (data)
+			munmap(const_cast<uint8_t*>(data), size);
+		if (fileDescriptor >= 0)
+			close(fileDescriptor);
+		fileDescriptor = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	bool WriteCheckpoint(const std::string& path, CheckpointHeader header, const CelestialObj* objects)
+	{
+		std::vector<uint32_t> hierarchy(header.objectCount);
+		for (uint64_t i = 0; i < header.objectCount; i++)
+		{
+			uint32_t sunIndex = static_cast<uint32_t>(objects[i].velocity.w) * header.systemSize;
+			hierarchy[i] = i == sunIndex ? CHECKPOINT_NO_PARENT : sunIndex + static_cast<uint32_t>(objects[i].posOffset.w);
+		}
+
+		header.hierarchyOffset = sizeof(CheckpointHeader);
+		header.objectsOffset = header.hierarchyOffset + hierarchy.size() * sizeof(uint32_t);
+		//Keep the object stream aligned for the GPU copy
+		header.objectsOffset = (header.objectsOffset + 15) & ~15ull;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		std::vector<char> padding(header.objectsOffset - header.hierarchyOffset - hierarchy.size() * sizeof(uint32_t), 0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CheckpointHeader));
+		file.write(reinterpret_cast<const char*>(hierarchy.data()), hierarchy.size() * sizeof(uint32_t));
+		file.write(padding.data(), padding.size());
+		file.write(reinterpret_cast<const char*>(objects), header.objectCount * sizeof(CelestialObj));
+		return file.good();
+	}
+
+	bool IsCheckpointFile(const MappedFile& file)
+	{
+		return file.GetSize() >= 4 && memcmp(file.GetData(), "ORVK", 4) == 0;
+	}
+
+	const CheckpointHeader* GetCheckpointHeader(const MappedFile& file)
+	{
+		if (!IsCheckpointFile(file))
+		{
+			spdlog::error("Checkpoint: Not a checkpoint file");
+			return nullptr;
+		}
+		if (file.GetSize() < sizeof(CheckpointHeader))
+		{
+			spdlog::error("Checkpoint: File is truncated");
+			return nullptr;
+		}
+
+		const CheckpointHeader* header = reinterpret_cast<const CheckpointHeader*>(file.GetData());
+		if (header->version != CHECKPOINT_VERSION)
+		{
+			spdlog::error("Checkpoint: Version {} is not supported", header->version);
+			return nullptr;
+		}
+		if (header->headerSize != sizeof(CheckpointHeader))
+		{
+			spdlog::error("Checkpoint: Header is {} bytes, this build expects {}", header->headerSize, sizeof(CheckpointHeader));
+			return nullptr;
+		}
+		if (header->objectSize != sizeof(CelestialObj))
+		{
+			spdlog::error("Checkpoint: Objects are {} bytes, this build expects {}", header->objectSize, sizeof(CelestialObj));
+			return nullptr;
+		}
+		if (header->hierarchyOffset < sizeof(CheckpointHeader) || header->hierarchyOffset + header->objectCount * sizeof(uint32_t) > header->objectsOffset)
+		{
+			spdlog::error("Checkpoint: Hierarchy overlaps the object stream");
+			return nullptr;
+		}
+		if (header->objectsOffset + header->objectCount * sizeof(CelestialObj) > file.GetSize())
+		{
+			spdlog::error("Checkpoint: File is truncated");
+			return nullptr;
+		}
+		return header;
+	}
+
+	const uint32_t* GetCheckpointHierarchy(const MappedFile& file)
+	{
+		const CheckpointHeader* header = GetCheckpointHeader(file);
+		return header ? reinterpret_cast<const uint32_t*>(file.GetData() + header->hierarchyOffset) : nullptr;
+	}
+
+	const CelestialObj* GetCheckpointObjects(const MappedFile& file)
+	{
+		const CheckpointHeader* header = GetCheckpointHeader(file);
+		return header ? reinterpret_cast<const CelestialObj*>(file.GetData() + header->objectsOffset) : nullptr;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include "Simulation.h"
+
+namespace sim {
+	const uint32_t CHECKPOINT_VERSION = 1;
+	const uint32_t CHECKPOINT_NO_PARENT = UINT32_MAX;
+
+	//File layout: header, hierarchy (one uint32_t parent index per object), then the raw CelestialObj stream as it sits on the GPU
+	struct CheckpointHeader {
+		char magic[4] = { 'O', 'R', 'V', 'K' };
+		uint32_t version = CHECKPOINT_VERSION;
+		uint32_t headerSize = sizeof(CheckpointHeader);
+		uint32_t objectSize = sizeof(CelestialObj);
+		uint64_t objectCount = 0;
+		uint32_t systemCount = 1;
+		uint32_t systemSize = 0;
+		double simulationTime = 0.0;
+		StepParams params;
+		uint64_t hierarchyOffset = 0;
+		uint64_t objectsOffset = 0;
+	};
+
+	//Read only view of a whole file, mapped rather than read so loading does no parsing or copying of its own
+	class MappedFile
+	{
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	public:
+		MappedFile() {};
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { Close(); }
+
+		bool Open(const std::string& path);
+		void Close();
+
+		const uint8_t* GetData() const { return data; }
+		size_t GetSize() const { return size; }
+	};
+
+	bool WriteCheckpoint(const std::string& path, CheckpointHeader header, const CelestialObj* objects);
+	//Checks the magic only and logs nothing, for telling binary scenarios from text ones
+	bool IsCheckpointFile(const MappedFile& file);
+	//Returns nullptr if the file is not a checkpoint this build can load
+	const CheckpointHeader* GetCheckpointHeader(const MappedFile& file);
+	//Parent index of each object, CHECKPOINT_NO_PARENT for the root of each system
+	const uint32_t* GetCheckpointHierarchy(const MappedFile& file);
+	const CelestialObj* GetCheckpointObjects(const MappedFile& file);
+}
+#endif
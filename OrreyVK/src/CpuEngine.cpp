@@ -0,0 +1,65 @@
+#include "CpuEngine.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace sim {
+
+	float CpuEngine::UpdateRotation(float currentRotation, float rotationSpeed)
+	{
+		float newRotation = currentRotation + rotationSpeed;
+		if (newRotation >= 2 * M_PI) { newRotation = 0; }
+		return newRotation;
+	}
+
+	void CpuEngine::StepObject(CelestialObj& object, const std::vector<CelestialObj>& massive)
+	{
+		float step = params.deltaT * params.speed;
+		uint32_t sunIndex = static_cast<uint32_t>(object.velocity.w) * params.systemSize;
+		const CelestialObj& sun = massive[sunIndex];
+
+		if (&object != &sun)
+		{
+			float xT = object.position.x / params.scale;
+			float zT = object.position.z / params.scale;
+			float xV = object.velocity.x;
+			float zV = object.velocity.z;
+
+			float radiusSquared = (xT * xT) + (zT * zT);
+			glm::vec3 forceDir = glm::normalize(glm::vec3(object.position));
+			glm::vec3 gravAcc = (forceDir * static_cast<float>(G)) / radiusSquared;
+
+			xV += gravAcc.x * step;
+			zV += gravAcc.z * step;
+
+			xT -= xV * step;
+			zT -= zV * step;
+
+			object.position.x = xT * params.scale;
+			object.position.z = zT * params.scale;
+
+			const CelestialObj& parent = massive[sunIndex + static_cast<uint32_t>(object.posOffset.w)];
+			object.posOffset.x = parent.position.x;
+			object.posOffset.z = parent.position.z;
+
+			object.velocity.x = xV;
+			object.velocity.z = zV;
+		}
+
+		object.rotation.x = UpdateRotation(object.rotation.x, object.rotationSpeed.x * step);
+		object.rotation.y = UpdateRotation(object.rotation.y, object.rotationSpeed.y * step);
+		object.rotation.z = UpdateRotation(object.rotation.z, object.rotationSpeed.z * step);
+	}
+
+	void CpuEngine::StepMassive(std::vector<CelestialObj>& massive)
+	{
+		//Planets first so moons pick up their parent's new position
+		for (auto& object : massive)
+			if (object.posOffset.w == 0.0f)
+				StepObject(object, massive);
+
+		for (auto& object : massive)
+			if (object.posOffset.w != 0.0f)
+				StepObject(object, massive);
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#ifndef CPUENGINE_H
+#define CPUENGINE_H
+
+#include <vector>
+#include "Simulation.h"
+
+namespace sim {
+	//CPU port of the step kernel in planets.comp
+	class CpuEngine
+	{
+	private:
+		StepParams params;
+
+		float UpdateRotation(float currentRotation, float rotationSpeed);
+	public:
+		CpuEngine() {};
+		CpuEngine(StepParams params) : params(params) {};
+
+		void SetParams(StepParams params) { this->params = params; }
+		StepParams GetParams() { return params; }
+
+		//Advances one object, parents are looked up in the massive bodies of its system
+		void StepObject(CelestialObj& object, const std::vector<CelestialObj>& massive);
+		//Advances the sun, planets and moons in the same order as the compute shader
+		void StepMassive(std::vector<CelestialObj>& massive);
+	};
+}
+#endif
@@ -0,0 +1,167 @@
+#include "DistributedSimulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+namespace sim {
+
+	void SharedMemoryTransport::BroadcastMassive(uint32_t rank, std::vector<CelestialObj>& massive)
+	{
+		if (rank == 0)
+			this->massive = massive;
+		Barrier();
+		if (rank != 0)
+			massive = this->massive;
+	}
+
+	void SharedMemoryTransport::SendMigrants(uint32_t rank, std::vector<std::vector<CelestialObj>>& outboxes)
+	{
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			mailboxes[rank * workerCount + i].swap(outboxes[i]);
+			outboxes[i].clear();
+		}
+	}
+
+	void SharedMemoryTransport::ReceiveMigrants(uint32_t rank, std::vector<CelestialObj>& particles)
+	{
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			std::vector<CelestialObj>& mailbox = mailboxes[i * workerCount + rank];
+			particles.insert(particles.end(), mailbox.begin(), mailbox.end());
+			mailbox.clear();
+		}
+	}
+
+	void SharedMemoryTransport::Barrier()
+	{
+		std::unique_lock<std::mutex> lock(barrierMutex);
+		uint64_t generation = barrierGeneration;
+		if (++barrierCount == workerCount)
+		{
+			barrierCount = 0;
+			barrierGeneration++;
+			barrierCondition.notify_all();
+		}
+		else
+		{
+			barrierCondition.wait(lock, [this, generation] { return generation != barrierGeneration; });
+		}
+	}
+
+	DistributedSimulation::DistributedSimulation(const std::vector<CelestialObj>& objects, uint32_t massiveCount, StepParams params, uint32_t workerCount)
+	{
+		transport.reset(new SharedMemoryTransport(workerCount));
+		workers.resize(workerCount);
+
+		std::vector<CelestialObj> massive(objects.begin(), objects.begin() + massiveCount);
+		std::vector<CelestialObj> particles(objects.begin() + massiveCount, objects.end());
+
+		//Equal count slices, split on the radius of each particle
+		std::sort(particles.begin(), particles.end(), [](const CelestialObj& a, const CelestialObj& b) { return SliceRadius(a) < SliceRadius(b); });
+		size_t sliceSize = (particles.size() + workerCount - 1) / workerCount;
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			size_t begin = std::min(particles.size(), i * sliceSize);
+			size_t end = std::min(particles.size(), begin + sliceSize);
+			workers[i].engine = CpuEngine(params);
+			workers[i].massive = massive;
+			workers[i].particles.assign(particles.begin() + begin, particles.begin() + end);
+			workers[i].outboxes.resize(workerCount);
+			if (i + 1 < workerCount)
+				sliceBoundaries.push_back(end < particles.size() ? SliceRadius(particles[end]) : std::numeric_limits<float>::max());
+		}
+	}
+
+	uint32_t DistributedSimulation::GetSlice(const CelestialObj& object)
+	{
+		return std::upper_bound(sliceBoundaries.begin(), sliceBoundaries.end(), SliceRadius(object)) - sliceBoundaries.begin();
+	}
+
+	void DistributedSimulation::RunWorker(uint32_t rank, uint32_t steps)
+	{
+		Worker& worker = workers[rank];
+		for (uint32_t step = 0; step < steps; step++)
+		{
+			if (rank == 0)
+				worker.engine.StepMassive(worker.massive);
+			transport->BroadcastMassive(rank, worker.massive);
+
+			//Step the slice, keeping particles that stay and handing off the ones that drift out of it
+			size_t kept = 0;
+			for (size_t i = 0; i < worker.particles.size(); i++)
+			{
+				CelestialObj& particle = worker.particles[i];
+				worker.engine.StepObject(particle, worker.massive);
+				uint32_t slice = GetSlice(particle);
+				if (slice == rank)
+					worker.particles[kept++] = particle;
+				else
+					worker.outboxes[slice].push_back(particle);
+			}
+			worker.migrated += worker.particles.size() - kept;
+			worker.particles.resize(kept);
+
+			transport->SendMigrants(rank, worker.outboxes);
+			transport->Barrier();
+			transport->ReceiveMigrants(rank, worker.particles);
+		}
+		transport->Barrier();
+	}
+
+	void DistributedSimulation::Run(uint32_t steps)
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < workers.size(); i++)
+			threads.emplace_back(&DistributedSimulation::RunWorker, this, i, steps);
+		RunWorker(0, steps);
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	std::vector<CelestialObj> DistributedSimulation::Gather()
+	{
+		std::vector<CelestialObj> objects = workers[0].massive;
+		for (auto& worker : workers)
+			objects.insert(objects.end(), worker.particles.begin(), worker.particles.end());
+		return objects;
+	}
+
+	uint64_t DistributedSimulation::GetMigratedCount()
+	{
+		uint64_t migrated = 0;
+		for (auto& worker : workers)
+			migrated += worker.migrated;
+		return migrated;
+	}
+
+	void RunScalingBenchmark(const std::vector<CelestialObj>& objects, uint32_t massiveCount, StepParams params, uint32_t maxWorkers, uint32_t steps)
+	{
+		spdlog::info("Worker benchmark: {} objects, {} steps, 1 to {} worker threads (CPU engine, shared memory transport)", objects.size(), steps, maxWorkers);
+
+		double singleWorkerTime = 0.0;
+		double previousSpeedup = 0.0;
+		for (uint32_t workerCount = 1; workerCount <= maxWorkers; workerCount++)
+		{
+			DistributedSimulation simulation(objects, massiveCount, params, workerCount);
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			simulation.Run(steps);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double time = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+			if (workerCount == 1)
+				singleWorkerTime = time;
+			double speedup = singleWorkerTime / time;
+
+			//Marginal efficiency is the share of one extra worker's throughput that adding it actually bought
+			spdlog::info("\t{} workers: {} ms/step, speedup {}, efficiency {}, marginal efficiency {}, migrated {}",
+				workerCount, time / steps, speedup, speedup / workerCount, speedup - previousSpeedup, simulation.GetMigratedCount());
+			previousSpeedup = speedup;
+		}
+	}
+}
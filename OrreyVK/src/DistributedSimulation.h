@@ -0,0 +1,84 @@
+#pragma once
+#ifndef DISTRIBUTEDSIMULATION_H
+#define DISTRIBUTEDSIMULATION_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "Simulation.h"
+#include "CpuEngine.h"
+
+namespace sim {
+	//Everything a worker exchanges with the others goes through here, so other transports (sockets, MPI) can replace the shared memory one
+	class Transport
+	{
+	public:
+		virtual ~Transport() {};
+
+		virtual uint32_t GetWorkerCount() = 0;
+		//Rank 0 owns the massive bodies and publishes them, every other rank receives a copy
+		virtual void BroadcastMassive(uint32_t rank, std::vector<CelestialObj>& massive) = 0;
+		//outboxes[i] holds the particles leaving this rank for rank i
+		virtual void SendMigrants(uint32_t rank, std::vector<std::vector<CelestialObj>>& outboxes) = 0;
+		//Appends the particles handed to this rank to particles
+		virtual void ReceiveMigrants(uint32_t rank, std::vector<CelestialObj>& particles) = 0;
+		virtual void Barrier() = 0;
+	};
+
+	//Workers share one address space and hand data over through shared buffers
+	class SharedMemoryTransport : public Transport
+	{
+	private:
+		uint32_t workerCount;
+		std::vector<CelestialObj> massive;
+		std::vector<std::vector<CelestialObj>> mailboxes; //Indexed [source * workerCount + destination]
+
+		std::mutex barrierMutex;
+		std::condition_variable barrierCondition;
+		uint32_t barrierCount = 0;
+		uint64_t barrierGeneration = 0;
+
+	public:
+		SharedMemoryTransport(uint32_t workerCount) : workerCount(workerCount), mailboxes(workerCount * workerCount) {};
+
+		uint32_t GetWorkerCount() { return workerCount; }
+		void BroadcastMassive(uint32_t rank, std::vector<CelestialObj>& massive);
+		void SendMigrants(uint32_t rank, std::vector<std::vector<CelestialObj>>& outboxes);
+		void ReceiveMigrants(uint32_t rank, std::vector<CelestialObj>& particles);
+		void Barrier();
+	};
+
+	//Partitions the test particles into radial slices, one per worker
+	class DistributedSimulation
+	{
+	private:
+		struct Worker {
+			CpuEngine engine;
+			std::vector<CelestialObj> massive;
+			std::vector<CelestialObj> particles;
+			std::vector<std::vector<CelestialObj>> outboxes;
+			uint64_t migrated = 0;
+		};
+
+		std::unique_ptr<Transport> transport;
+		std::vector<Worker> workers;
+		std::vector<float> sliceBoundaries; //Upper radius of each slice bar the last
+
+		static float SliceRadius(const CelestialObj& object) { return glm::length(glm::vec2(object.position.x, object.position.z)); }
+		uint32_t GetSlice(const CelestialObj& object);
+		void RunWorker(uint32_t rank, uint32_t steps);
+
+	public:
+		DistributedSimulation(const std::vector<CelestialObj>& objects, uint32_t massiveCount, StepParams params, uint32_t workerCount);
+
+		void Run(uint32_t steps);
+		std::vector<CelestialObj> Gather();
+		uint64_t GetMigratedCount();
+		uint32_t GetWorkerCount() { return workers.size(); }
+	};
+
+	//Times the same run with 1..maxWorkers workers and logs speedup and efficiency
+	void RunScalingBenchmark(const std::vector<CelestialObj>& objects, uint32_t massiveCount, StepParams params, uint32_t maxWorkers, uint32_t steps);
+}
+#endif
@@ -4,11 +4,68 @@
 #define HEIGHT 1080
 #define FULLSCREEN false
 
-#define OBJECTS_PER_GROUP 512
-#define SATURN_RING_OBJECT_COUNT 6000
-#define ASTROID_BELT_MAX_OBJECT_COUNT 250000
+#define OBJECTS_PER_GROUP 512 //Also the size of a culling cluster, must be a power of two
 #define SCALE 30
 
+#define ENSEMBLE_SYSTEM_COUNT 1 //Number of independent copies of the system simulated side by side. --ensemble overrides it
+#define ENSEMBLE_PERTURBATION 1e-4 //Relative standard deviation applied to the velocities of each copy
+#define DIAGNOSTICS_GROUP_SIZE 256
+
+#define RECORD_STEP_INTERVAL 6 //Simulation steps between trajectory snapshots, 10Hz at 60fps with one step a frame
+#define RECORD_RING_SIZE 4 //Readback buffers a snapshot can wait in until the writer thread has read it
+
+#define KEYFRAME_STEP_INTERVAL 60 //Steps between keyframes, the most a seek has to fast forward
+#define KEYFRAME_MEMORY_BUDGET_MB 256 //VRAM given to the keyframe ring, sets how far back the timeline reaches
+#define KEYFRAME_STRIDE 7 //uints kept per object, must match keyframe.comp
+
+#define ORBIT_MAX_TRACKED 4096 //Bodies with an orbit drawn, the heaviest come first in every scenario
+#define ORBIT_MAX_SEGMENTS 256 //Line segments for the largest orbits, smaller ones use fewer
+#define ORBIT_TOLERANCE 0.02f //Largest gap between a segment and the true orbit, in world units
+#define ORBIT_GROUP_SIZE 64
+
+#define PREVIEW_MAX_SELECTION 32 //Must match preview.comp
+#define PREVIEW_MAX_PERTURBERS 32 //Massive bodies whose pull the preview adds, must match preview.comp
+#define PREVIEW_STEPS 8192 //Steps integrated ahead of the selected bodies
+#define PREVIEW_STEP_STRIDE 16 //Steps between the points of a preview path
+#define PREVIEW_STEPS_PER_FRAME 512 //Budget for one frame, a preview takes PREVIEW_STEPS / PREVIEW_STEPS_PER_FRAME frames to build
+
+#define CULL_MIN_PIXEL_SIZE 1.0f //Objects narrower than this on screen are splatted into a single pixel, or not drawn without 64 bit atomics
+
+#define AGGREGATE_MIN_COUNT 1000 //Rings and belts with at least this many members are drawn as a density annulus from a distance
+#define AGGREGATE_MAX_POPULATIONS 8
+#define AGGREGATE_BINS (32 * 256) //Radial times angular bins per population, must match aggregate.glsl
+#define AGGREGATE_SEGMENTS 128 //Quads around the annulus, must match aggregate.glsl
+#define AGGREGATE_REBIN_INTERVAL 30 //Frames between the members being counted into the bins again, they drift slowly
+#define AGGREGATE_FADE_PIXEL_SIZE 1.0f //Members narrower than this on screen are all drawn as the annulus, by twice it they are all drawn themselves
+#define AGGREGATE_GROUP_SIZE 256 //Must match aggregate.comp
+
+#define SPHERE_LOD_COUNT 4 //Levels of detail from 20x20 down to an octahedron, or down to an icosahedron, must match cull.comp
+#define SPHERE_ICOSPHERE false //Geodesic sphere instead of stacks and slices, rounder silhouettes for the same triangle count
+#define SPHERE_ICOSPHERE_FREQUENCY 6 //Splits along each icosahedron edge on the most detailed level, 720 triangles
+#define SPHERE_LOD_PIXEL_SIZE 64.0f //Objects narrower than this on screen drop a level, and another each time the size halves
+#define AMPLIFY_COPIES 4 //Render instances drawn per simulated test particle at full quality, each copy after the first hashed to elsewhere on a nearby orbit. 1 turns it off
+#define IMPOSTOR_PIXEL_SIZE 16.0f //Objects narrower than this on screen are ray cast onto a quad instead of meshed, 0 turns impostors off
+#define CULL_BUCKET_COUNT (SPHERE_LOD_COUNT + 1) //Each level of detail then the impostors, must match cull.comp
+#define SKY_GROUP_SIZE 16 //Texels each way per workgroup converting the sky, must match sky.comp
+#define HIZ_MAX_LEVELS 16 //Depth pyramid levels descriptors are reserved for, enough for a 32k wide window
+#define VISIBILITY_BUFFER false //Rasterize object and triangle ids single sampled and shade every pixel once in a full screen pass, instead of shading forward with MSAA
+#define MULTIVIEW_COUNT 1 //Views drawn in one pass, side by side across the window. --views overrides it
+#define MULTIVIEW_MAX_VIEWS 4 //Must match views.glsl and m_graphics.ubo.views
+#define MULTIVIEW_EYE_SEPARATION 0.0f //World units between neighbouring views for a stereo rig, 0 turns them instead to tile a wall of displays. --eye-separation overrides it
+#define COMMAND_RECORD_THREADS 4 //Threads each frame's passes are recorded on, the main one included. Capped at the hardware's
+#define ANTI_ALIASING 1 //Mode to start in, 0 off, 1 MSAA, 2 FXAA, 3 temporal. F7 cycles through the ones the device supports
+#define TAA_BLEND 0.1f //Weight of the newest frame in the temporal history
+#define TAA_JITTER_PHASES 8 //Halton(2, 3) sub-pixel offsets cycled through
+#define SIMULATION_SUBSTEPS 2 //Steps a frame's time is split into at full quality while the governor runs, it can go down to one. Off, a frame is a single step
+#define FRAME_BUDGET_MS 0.0f //Frame time the governor holds to, 0 switches it off and leaves every knob where it starts. --frame-budget overrides it
+#define GOVERNOR_WINDOW 30 //Frames averaged for each decision
+#define GOVERNOR_OVER_BUDGET 1.1f //A window over this much of the budget turns a knob down
+#define GOVERNOR_UNDER_BUDGET 0.75f //GPU time under this much of the budget, GOVERNOR_RAISE_WINDOWS windows in a row, turns one back up
+#define GOVERNOR_RAISE_WINDOWS 3
+#define GOVERNOR_SCALE_STEP 0.125f //Render scale given up each level
+#define GOVERNOR_MIN_SCALE 0.5f
+#define GOVERNOR_MAX_BIAS 2 //Times SPHERE_LOD_PIXEL_SIZE and IMPOSTOR_PIXEL_SIZE can be doubled
+
 void OrreyVk::Run() {
 	InitWindow();
 	Init();
@@ -38,22 +95,36 @@ void OrreyVk::InitWindow() {
 }
 
 void OrreyVk::Init() {
+	m_multisample = !VISIBILITY_BUFFER && ANTI_ALIASING == 1;
+	//InitVulkan falls back to one view if the device cannot draw this many in a pass
+	m_viewCount = std::max(std::min<uint32_t>(m_multiview.count > 0 ? m_multiview.count : MULTIVIEW_COUNT, MULTIVIEW_MAX_VIEWS), 1u);
+	if (m_multiview.eyeSeparation < 0.0f)
+		m_multiview.eyeSeparation = MULTIVIEW_EYE_SEPARATION;
+	m_recordThreads = std::max(std::min<uint32_t>(COMMAND_RECORD_THREADS, std::thread::hardware_concurrency()), 1u);
 	InitVulkan(m_window);
 
-	m_sphere = SolidSphere(0.5, 20, 20);
+	m_sphere = SPHERE_ICOSPHERE ? SolidSphere::Icosphere(0.5, SPHERE_ICOSPHERE_FREQUENCY, SPHERE_LOD_COUNT) : SolidSphere(0.5, 20, 20, SPHERE_LOD_COUNT);
+	m_sphere.AddImpostorQuad();
+	for (size_t lod = 0; lod < m_sphere.GetLods().size(); lod++)
+	{
+		const SolidSphere::CacheStats& stats = m_sphere.GetCacheStats()[lod];
+		spdlog::info("Sphere LOD {}: {} triangles, {} vertices, ACMR {:.3f} -> {:.3f}", lod, m_sphere.GetLods()[lod].indexCount / 3, stats.vertexCount, stats.acmrBefore, stats.acmrAfter);
+	}
 
 	//Setup vertex and ubo buffer for graphics
 	vko::Buffer vertexStagingBuffer = CreateBuffer(m_sphere.GetVerticesSize(), vk::BufferUsageFlagBits::eTransferSrc, m_sphere.GetVertices().data());
 	vko::Buffer indexStagingBuffer = CreateBuffer(m_sphere.GetIndiciesSize(), vk::BufferUsageFlagBits::eTransferSrc, m_sphere.GetIndicies().data());
-	m_bufferVertex = CreateBuffer(m_sphere.GetVerticesSize(), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	m_bufferIndex = CreateBuffer(m_sphere.GetIndiciesSize(), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	//Also read as storage buffers by the visibility buffer's shading pass, the indices rounded up to whole words for it
+	m_bufferVertex = CreateBuffer(m_sphere.GetVerticesSize(), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_bufferIndex = CreateBuffer((m_sphere.GetIndiciesSize() + 3) & ~3, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
 
 	CopyBuffer(vertexStagingBuffer, m_bufferVertex, m_sphere.GetVerticesSize());
 	CopyBuffer(indexStagingBuffer, m_bufferIndex, m_sphere.GetIndiciesSize());
 	spdlog::info("Created Buffers");
 
-	m_graphics.ubo.projection = glm::perspective(glm::radians(60.0f), m_vulkanResources->swapchain.GetDimensions().width / (float)m_vulkanResources->swapchain.GetDimensions().height, 0.1f, std::numeric_limits<float>::max());
+	//Every view has the same projection, its share of the window
+	m_graphics.ubo.projection = glm::perspective(glm::radians(60.0f), m_renderExtent.width / (float)m_renderExtent.height, 0.1f, std::numeric_limits<float>::max());
 
 	m_graphics.ubo.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0, 0.0, m_camera.zoom));
 	m_camera.rotation.x = -90.0;
@@ -64,6 +135,8 @@ void OrreyVk::Init() {
 	m_graphics.ubo.view = glm::rotate(m_graphics.ubo.view, glm::radians(m_camera.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
 	m_graphics.ubo.model = glm::mat4(1.0f);
+	m_graphics.ubo.viewProjection = m_graphics.ubo.projection * m_graphics.ubo.view * m_graphics.ubo.model;
+	UpdateViews();
 
 	m_graphics.uniformBuffer = CreateBuffer(sizeof(m_graphics.ubo), vk::BufferUsageFlagBits::eUniformBuffer);
 	m_graphics.uniformBuffer.Map();
@@ -89,125 +162,197 @@ void OrreyVk::Init() {
 	};
 
 	m_textureArrayPlanets = Create2DTextureArray(vk::Format::eR8G8B8A8Unorm, paths, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, true);
-	m_textureStarfield = CreateTexture(vk::ImageType::e2D, vk::Format::eR8G8B8A8Srgb, "resources/starsmilkyway8k.jpg", vk::ImageUsageFlagBits::eSampled, true);
 
 	spdlog::info("Loaded textures");
 	
 	
 	//Create query pool to time compute, and rendering times
-	vk::QueryPoolCreateInfo queryPoolInfo = vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 2, {});
+	//0-1 Compute step, 2-3 Keyframe capture, 4-6 Scene and anti-aliasing, 7 onwards Instance draw.
+	//Timestamps written inside a multiview render pass take one query per view, so the end of the instance draw has MULTIVIEW_MAX_VIEWS
+	vk::QueryPoolCreateInfo queryPoolInfo = vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 8 + MULTIVIEW_MAX_VIEWS, {});
 	m_queryPool = m_vulkanResources->device.createQueryPool(queryPoolInfo);
 	m_queryResults.resize(2);
 
 	PrepareInstance();
 
 	CreateDescriptorPool();
+	PrepareSky();
+	PrepareSplats();
+	PrepareOcclusion();
+	PrepareAggregates();
+	PrepareCulling();
 	CreateDescriptorSetLayout();
 	CreateDescriptorSet();
 
 	CreateGraphicsPipelineLayout();
 	CreateGraphicsPipeline();
+	PrepareVisibility();
+	PrepareAntiAliasing();
+	PrepareGovernor();
 	PrepareCompute();
-
-	CreateCommandBuffers();
+	PrepareOrbits();
+	PreparePreview();
+	spdlog::info("Recording frames on {} threads", m_vulkanResources->commandRecorder.GetThreadCount());
+
+	//Post passes need their own targets, they are switched to once everything else exists the same way F7 does
+	m_aa.mode = m_msaaSamples != vk::SampleCountFlagBits::e1 ? AntiAliasing::eMsaa : AntiAliasing::eOff;
+	if (ANTI_ALIASING > 1)
+		SetAntiAliasing(static_cast<AntiAliasing>(ANTI_ALIASING));
+	spdlog::info("Anti-aliasing: {}", GetAntiAliasingName(m_aa.mode));
+
+	//A render scale pinned below full is switched to the same way the governor switches it
+	const GovernorKnobState& renderScale = m_governor.knobs[static_cast<size_t>(GovernorKnob::eRenderScale)];
+	if (renderScale.level > 0)
+		SetGovernorLevel(GovernorKnob::eRenderScale, renderScale.level);
+	ReportGovernor();
 }
 
 void OrreyVk::PrepareInstance()
 {
-	std::vector<CelestialObj> objects;
-	std::default_random_engine rndGenerator((unsigned)time(nullptr));
-	std::uniform_real_distribution<float> uniformDist(0.0, 1.0);
-
-	int objectsToSpawn = 13 + SATURN_RING_OBJECT_COUNT + ASTROID_BELT_MAX_OBJECT_COUNT;
-	while (objectsToSpawn % OBJECTS_PER_GROUP != 0) //Reduce astroid count until it divides nicely with objects per group
-		objectsToSpawn--;
-
-	//Converted G constant for AU/SM, T: 1s ~= 1 earth sidereal day
-	const double G = 0.0002959122083;
-	auto initialVelocity = [G](float r, float mass = 1.0) { return sqrt((G * mass) / r);  };
-	auto degToRad = [](float deg) {return deg * M_PI / 180; };
-
-	objects.resize(objectsToSpawn);
-	objects[0] = { glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0, 0.0, 0.0, 0.0), glm::vec4(5, 5, 5, 0), glm::vec4(degToRad(-7.25), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(15.228), 0.0, 0.0) }; //Sun
-	//				Distance in AU						 Mass in Solar Mass,				Velocity in AU					Scale as ratio of Earth			Texture index   Rotation in degrees					Rotation Speed 
-	objects[1] = { glm::vec4(0.39	* SCALE, 0.0f, 0.0f, 1.651502e-7),	glm::vec4(0.0, 0.0,	initialVelocity(0.39),	0.0),	glm::vec4(0.37, 0.37, 0.37,			1),	glm::vec4(degToRad(-0.01), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(6.12), 0.0, 0.0) }; //Mercury
-	objects[2] = { glm::vec4(0.723	* SCALE, 0.0f, 0.0f, 2.447225e-6),	glm::vec4(0.0, 0.0, initialVelocity(0.723), 0.0),	glm::vec4(0.949, 0.949, 0.949,		2), glm::vec4(degToRad(-117.4), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(-1.476), 0.0, 0.0) }; //Venus
-	objects[3] = { glm::vec4(1.0	* SCALE, 0.0f, 0.0f, 3.0027e-6),	glm::vec4(0.0, 0.0, initialVelocity(1.0),	0.0),	glm::vec4(1.0, 1.0, 1.0,			3), glm::vec4(degToRad(-23.5), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(360), 0.0, 0.0) }; //Earth
-	objects[4] = { glm::vec4(1.524	* SCALE, 0.0f, 0.0f, 3.212921e-7),	glm::vec4(0.0, 0.0, initialVelocity(1.524), 0.0),	glm::vec4(0.532, 0.532, 0.532,		4), glm::vec4(degToRad(-25.19), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(345.6), 0.0, 0.0) }; //Mars
-	objects[5] = { glm::vec4(5.2	* SCALE, 0.0f, 0.0f, 9.543e-4),		glm::vec4(0.0, 0.0, initialVelocity(5.2),	0.0),	glm::vec4(10.97, 10.97, 10.97,		5), glm::vec4(degToRad(-3.13), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(864), 0.0, 0.0) }; //Jupiter
-	objects[6] = { glm::vec4(9.5	* SCALE, 0.0f, 0.0f, 2.857e-4),		glm::vec4(0.0, 0.0, initialVelocity(9.5),	0.0),	glm::vec4(9.14, 9.14, 9.14,			6), glm::vec4(degToRad(-26.73), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(785.448), 0.0, 0.0) }; //Saturn
-	objects[7] = { glm::vec4(19.2	* SCALE, 0.0f, 0.0f, 4.365e-5),		glm::vec4(0.0, 0.0, initialVelocity(19.2),	0.0),	glm::vec4(3.98, 3.98, 3.98,			7), glm::vec4(degToRad(-97.77), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(-508.248), 0.0, 0.0) }; //Uranus
-	objects[8] = { glm::vec4(30.0	* SCALE, 0.0f, 0.0f, 5.149e-5),		glm::vec4(0.0, 0.0, initialVelocity(30.0),	0.0),	glm::vec4(3.86, 3.86, 3.86,			8), glm::vec4(degToRad(-28.32), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(540), 0.0, 0.0) }; //Neptune
-
-	//Moons
-	objects[9] = { glm::vec4((0.15) * SCALE, 0.0f, 0.0f, 3.69432e-8), glm::vec4(0.0, 0.0, initialVelocity(0.15),		0.0),	glm::vec4(0.27, 0.27, 0.27,			9), glm::vec4(degToRad(-1.5), 0.0, 0.0, 0.0),	glm::vec4(0.0f, degToRad(13.33), 0.0, 0.0), glm::vec4(objects[3].position.x, objects[3].position.y, objects[3].position.z, 3.0) };		//Moon
-	objects[9].orbitalTilt = glm::vec4(degToRad(5.14), 0.0, 0.0, 0.0);
-	
-	objects[10] = { glm::vec4((2.2) * SCALE, 0.0f, 0.0f,	3.69432e-8), glm::vec4(0.0, 0.0, initialVelocity(2.2),		0.0),	glm::vec4(0.4, 0.4, 0.4,			6),glm::vec4(degToRad(0.0), 0.0, 0.0, 0.0),		glm::vec4(0.0f, degToRad(22.5), 0.0, 0.0), glm::vec4(objects[6].position.x, objects[6].position.y, objects[6].position.z, 6.0) };		//Titan
-	objects[10].colourTint = glm::vec4(0.9, 0.89, 0.36, 1.0);
-	objects[10].orbitalTilt = glm::vec4(degToRad(-26.73), 0.0, 0.0, 0.0);
-
-	objects[11] = { glm::vec4((1.5) * SCALE, 0.0f, 0.0f,	3.69432e-8), glm::vec4(0.0, 0.0, initialVelocity(1.5),		0.0),	glm::vec4(0.12, 0.12, 0.12,			1),glm::vec4(degToRad(0.0), 0.0, 0.0, 0.0),		glm::vec4(0.0f, degToRad(80.0), 0.0, 0.0), glm::vec4(objects[6].position.x, objects[6].position.y, objects[6].position.z, 6.0) };		//Rhea
-	objects[11].orbitalTilt = glm::vec4(degToRad(-26.73), 0.0, 0.0, 0.0);
-
-	objects[12] = { glm::vec4((1.8) * SCALE, 0.0f, 0.0f,	3.69432e-8), glm::vec4(0.0, 0.0, initialVelocity(1.8),		0.0),	glm::vec4(0.41, 0.41, 0.41,			1),glm::vec4(degToRad(0.0), 0.0, 0.0, 0.0),		glm::vec4(0.0f, degToRad(50.52), 0.0, 0.0), glm::vec4(objects[5].position.x, objects[5].position.y, objects[5].position.z, 5.0) };		//Ganymede
-	objects[12].orbitalTilt = glm::vec4(degToRad(-3.13), 0.0, 0.0, 0.0);
-
-	//Saturn ring
-	for (int i = 13; i < SATURN_RING_OBJECT_COUNT + 13; i++)
-	{
-		glm::vec2 ring0{ 0.3 * SCALE, 0.8 * SCALE };
-		float rho, theta;
-		rho = sqrt((pow(ring0[1], 2.0f) - pow(ring0[0], 2.0f)) * uniformDist(rndGenerator) + pow(ring0[0], 2.0f));
-		theta = 2.0 * M_PI * uniformDist(rndGenerator);
-		objects[i].position = glm::vec4(rho*cos(theta), uniformDist(rndGenerator) * 0.5f - 0.25f, rho*sin(theta), 3.69432e-32);
-		float r = sqrt(pow(objects[i].position.x, 2) + pow(objects[i].position.z, 2));
-		float vel = initialVelocity(r /SCALE); //Velocity calculation needs to be in unscaled AU
-	
-		float mag = sqrt(glm::dot(objects[i].position, objects[i].position));
-		glm::vec3 normalisedPos = glm::vec3(objects[i].position.x / mag, objects[i].position.y, objects[i].position.z / mag);
-	
-		objects[i].velocity = glm::vec4((-normalisedPos.z * vel), 0.0f, (normalisedPos.x * vel), 0.0f); //CCW rotation
-		objects[i].scale = glm::vec4(RandomRange(0.01, 0.07), RandomRange(0.01, 0.07), RandomRange(0.01, 0.07), 1);
-		objects[i].rotation = glm::vec4(M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), 0.0f);
-		objects[i].rotationSpeed = glm::vec4(1.0 * uniformDist(rndGenerator), 1.0 * uniformDist(rndGenerator), 1.0 * uniformDist(rndGenerator), 0.0f);
-		objects[i].posOffset = glm::vec4(objects[6].position.x, objects[6].position.y, objects[6].position.z, 6.0);
-		objects[i].orbitalTilt = objects[6].rotation;
-		float colourTint = 0.5 * uniformDist(rndGenerator) + 0.4;
-		objects[i].colourTint = glm::vec4(colourTint, colourTint, colourTint, 1.0);
+	sim::MappedFile binaryFile;
+	const CelestialObj* binaryObjects = nullptr;
+	const uint32_t* binaryHierarchy = nullptr;
+	sim::Scenario scenario;
+	uint64_t objectCount = 0;
+	uint32_t paddingCount = 0;
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	//Checkpoints double as binary scenarios, either is copied straight from the mapped file into the staging buffer
+	//Text scenarios only stage their explicit bodies, populations are generated on the GPU by populate.comp
+	bool restoring = !m_checkpoint.restorePath.empty();
+	std::string binaryPath = restoring ? m_checkpoint.restorePath : m_scenarioPath;
+	//Only a file that has to be a checkpoint, or claims to be one, is worth reporting parse errors for
+	const sim::CheckpointHeader* header = nullptr;
+	if (binaryFile.Open(binaryPath) && (restoring || sim::IsCheckpointFile(binaryFile)))
+		header = sim::GetCheckpointHeader(binaryFile);
+	//Positions are stored scaled, they can't be stepped at any other scale
+	if (header && header->params.scale != SCALE)
+	{
+		spdlog::error("Checkpoint: {} was saved at scale {}, this build simulates at {}", binaryPath, header->params.scale, SCALE);
+		header = nullptr;
 	}
-	
-	//Astroid belt
-	for (int i = SATURN_RING_OBJECT_COUNT + 13; i < objectsToSpawn; i++)
-	{
-		glm::vec2 ring0{ 2 * SCALE, 3 * SCALE };
-		float rho, theta;
-		rho = sqrt((pow(ring0[1], 2.0f) - pow(ring0[0], 2.0f)) * uniformDist(rndGenerator) + pow(ring0[0], 2.0f));
-		theta = 2.0 * M_PI * uniformDist(rndGenerator);
-		objects[i].position = glm::vec4(rho*cos(theta), uniformDist(rndGenerator) * 0.5f - 0.25f, rho*sin(theta), 3.69432e-32);
-		float r = sqrt(pow(objects[i].position.x, 2) + pow(objects[i].position.z, 2));
-		float vel = initialVelocity(r / SCALE);
-	
-		float mag = sqrt(glm::dot(objects[i].position, objects[i].position));
-		glm::vec3 normalisedPos = glm::vec3(objects[i].position.x / mag, objects[i].position.y, objects[i].position.z / mag);
-		
-		objects[i].velocity = glm::vec4((normalisedPos.z * vel), 0.0f, (-normalisedPos.x * vel), 0.0f); //CW rotation
-		objects[i].scale = glm::vec4(RandomRange(0.01, 0.07), RandomRange(0.01, 0.07), RandomRange(0.01, 0.07), 1);
-		objects[i].rotation = glm::vec4(M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), 0.0f);
-		objects[i].rotationSpeed = glm::vec4(1.0 * uniformDist(rndGenerator), 1.0 * uniformDist(rndGenerator), 1.0 * uniformDist(rndGenerator), 0.0f);
-		float colourTint = 0.5 * uniformDist(rndGenerator) + 0.4;
-		objects[i].colourTint = glm::vec4(colourTint, colourTint, colourTint, 1.0);
+	if (header)
+	{
+		binaryObjects = sim::GetCheckpointObjects(binaryFile);
+		binaryHierarchy = sim::GetCheckpointHierarchy(binaryFile);
+		objectCount = header->objectCount;
+		m_ensemble.systemCount = header->systemCount;
+		m_ensemble.systemSize = header->systemSize;
+		if (restoring)
+		{
+			m_simulationTime = header->simulationTime;
+			m_speed = header->params.speed;
+			//The compute deltaT is split from the frame time, so the first frame takes the step the checkpoint was saved with
+			m_frameTime = header->params.deltaT * m_governor.substeps;
+			spdlog::info("Checkpoint: Restoring {} objects at t = {} from {}", objectCount, m_simulationTime, binaryPath);
+		}
+		else
+			spdlog::info("Scenario: Loading {} objects from {}", objectCount, binaryPath);
+	}
+	else
+	{
+		if (restoring)
+			spdlog::error("Checkpoint: Could not load {}, starting {} instead", binaryPath, m_scenarioPath);
+		if (!sim::LoadScenario(m_scenarioPath, scenario))
+			throw std::runtime_error("Scenario: Could not load " + m_scenarioPath);
+
+		//Ensemble - perturbed copies of the system are laid out after the reference one
+		//Each copy starts on a planets.comp workgroup, so its moons share a workgroup and its barrier with their parents wherever the reference system's do
+		uint64_t scenarioSize = scenario.GetObjectCount();
+		m_ensemble.systemCount = m_ensemble.requestedCount > 0 ? m_ensemble.requestedCount : ENSEMBLE_SYSTEM_COUNT;
+		uint64_t systemSize = m_ensemble.systemCount > 1 ? (scenarioSize + OBJECTS_PER_GROUP - 1) / OBJECTS_PER_GROUP * OBJECTS_PER_GROUP : scenarioSize;
+		paddingCount = static_cast<uint32_t>(systemSize - scenarioSize);
+		m_ensemble.systemSize = static_cast<uint32_t>(systemSize);
+		objectCount = systemSize * m_ensemble.systemCount;
+		spdlog::info("Scenario: {} bodies and {} populations from {}", scenario.bodies.size(), scenario.populations.size(), m_scenarioPath);
+		spdlog::info("Ensemble: {} systems of {} objects", m_ensemble.systemCount, m_ensemble.systemSize);
+	}
+
+	//Bound whole as one storage buffer and indexed with 32 bit integers in the shaders
+	vk::DeviceSize size = objectCount * sizeof(CelestialObj);
+	vk::DeviceSize maxSize = m_vulkanResources->physicalDevice.getProperties().limits.maxStorageBufferRange;
+	if (objectCount > INT32_MAX || size > maxSize)
+		throw std::runtime_error("Scenario: " + std::to_string(objectCount) + " objects need " + std::to_string(size) + " bytes, the device allows " + std::to_string(maxSize) + " per storage buffer");
+	uint64_t stagedCount = binaryObjects ? objectCount : (scenario.bodies.size() + paddingCount) * m_ensemble.systemCount;
+	vko::Buffer instanceStagingBuffer = CreateBuffer(stagedCount * sizeof(CelestialObj), vk::BufferUsageFlagBits::eTransferSrc);
+	instanceStagingBuffer.Map();
+	CelestialObj* objects = static_cast<CelestialObj*>(instanceStagingBuffer.mapped);
+	std::vector<vk::BufferCopy> copyRegions;
+	if (binaryObjects)
+	{
+		//Written straight into the staging buffer by every hardware thread
+		sim::ParallelFor(objectCount, sim::SCENARIO_CHUNK_SIZE, [&](uint64_t begin, uint64_t end)
+		{
+			std::copy(binaryObjects + begin, binaryObjects + end, objects + begin);
+
+			//The hierarchy is authoritative, parents are stored as offsets from their system's first object
+			for (uint64_t i = begin; i < end; i++)
+			{
+				uint32_t sunIndex = static_cast<uint32_t>(objects[i].velocity.w) * m_ensemble.systemSize;
+				if (binaryHierarchy[i] != sim::CHECKPOINT_NO_PARENT)
+					objects[i].posOffset.w = static_cast<float>(binaryHierarchy[i] - sunIndex);
+			}
+		});
+		copyRegions.emplace_back(0, 0, size);
+	}
+	else
+	{
+		vk::DeviceSize bodiesSize = scenario.bodies.size() * sizeof(CelestialObj);
+		vk::DeviceSize paddingSize = paddingCount * sizeof(CelestialObj);
+		for (uint32_t system = 0; system < m_ensemble.systemCount; system++)
+		{
+			CelestialObj* bodies = objects + system * scenario.bodies.size();
+			uint32_t systemOffset = system * m_ensemble.systemSize;
+			sim::GenerateBodies(scenario, SCALE, system, ENSEMBLE_PERTURBATION, bodies);
+			copyRegions.emplace_back(system * bodiesSize, systemOffset * sizeof(CelestialObj), bodiesSize);
+
+			//Padding is staged after every system's bodies and copied in after its populations, nothing steps, draws or measures it
+			if (paddingCount > 0)
+			{
+				CelestialObj* padding = objects + m_ensemble.systemCount * scenario.bodies.size() + system * paddingCount;
+				CelestialObj placeholder = {};
+				placeholder.position.w = -1.0f;
+				placeholder.velocity.w = static_cast<float>(system);
+				std::fill(padding, padding + paddingCount, placeholder);
+				copyRegions.emplace_back((padding - objects) * sizeof(CelestialObj), (systemOffset + m_ensemble.systemSize - paddingCount) * sizeof(CelestialObj), paddingSize);
+			}
+
+			std::vector<sim::PopulationParams> populations = sim::GetPopulationParams(scenario, bodies, SCALE, system, ENSEMBLE_PERTURBATION, systemOffset);
+			m_population.pending.insert(m_population.pending.end(), populations.begin(), populations.end());
+
+			//Only the reference system is drawn, its big rings and belts can stand in for their members from a distance
+			for (const sim::PopulationParams& params : populations)
+			{
+				if (system > 0 || params.count < AGGREGATE_MIN_COUNT || m_aggregate.populations.size() == AGGREGATE_MAX_POPULATIONS)
+					continue;
+
+				//Member scales are uniform over the range, so their mean square is the range's
+				float minScale = params.appearance.x;
+				float maxScale = params.appearance.y;
+				float brightness = 0.5f * (params.appearance.z + params.appearance.w);
+				Aggregate aggregate = {};
+				aggregate.first = params.offset;
+				aggregate.count = params.count;
+				aggregate.inner = params.radii.x;
+				aggregate.outer = params.radii.y;
+				aggregate.colour = glm::vec4(brightness, brightness, brightness, params.texture);
+				aggregate.centre = glm::vec4(glm::vec3(params.parentPosition), 0.0f);
+				aggregate.tilt = params.parentPosition.w != 0.0f ? params.parentRotation : glm::vec4(0.0f);
+				aggregate.memberSize = maxScale;
+				aggregate.memberArea = float(M_PI) * 0.25f * (minScale * minScale + minScale * maxScale + maxScale * maxScale) / 3.0f;
+				m_aggregate.populations.push_back(aggregate);
+				m_aggregate.maxCount = std::max(m_aggregate.maxCount, params.count);
+			}
+		}
 	}
+	spdlog::info("Scenario: {} objects staged in {}ms", stagedCount, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
 
 	//Upload instance data into its buffer
-	uint32_t size = objects.size() * sizeof(CelestialObj);
-	vko::Buffer instanceStagingBuffer = CreateBuffer(size, vk::BufferUsageFlagBits::eTransferSrc, objects.data());
 	m_bufferInstance = CreateBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
 	vk::CommandBuffer cmdBuffer = m_vulkanResources->commandPool.AllocateCommandBuffer();
 	cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
-	//CopyBuffer(instanceStagingBuffer, m_bufferInstance, size);
-	cmdBuffer.copyBuffer(instanceStagingBuffer.buffer, m_bufferInstance.buffer, vk::BufferCopy(0, 0, size));
+	cmdBuffer.copyBuffer(instanceStagingBuffer.buffer, m_bufferInstance.buffer, copyRegions);
 
 	//Give compute queue ownership of the instance buffer so it's ready for the render loop
 	if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
@@ -228,105 +373,513 @@ void OrreyVk::PrepareInstance()
 	m_vulkanResources->device.destroyFence(fence);
 	m_vulkanResources->commandPool.FreeCommandBuffers(cmdBuffer);
 
-	instanceStagingBuffer.Destroy();
+	spdlog::info("Uploaded {} objects in {}ms", stagedCount, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
 
-	//Roughly calculate the orbits for drawing
-	std::vector<glm::vec2> allPoints;
-	int offset = 0;
-	for (int i = 1; i < 9; i++)
+	//Orbits are drawn for every body heavy enough to matter, test particles are left out
+	const CelestialObj* orbitObjects = objects;
+	uint64_t orbitCandidates = binaryObjects ? m_ensemble.systemSize : scenario.bodies.size();
+	std::vector<uint32_t> tracked;
+	for (uint64_t i = 1; i < orbitCandidates && tracked.size() < ORBIT_MAX_TRACKED; i++)
+	{
+		if (orbitObjects[i].position.w >= 1e-20f)
+			tracked.push_back(static_cast<uint32_t>(i));
+	}
+	if (tracked.size() == ORBIT_MAX_TRACKED)
+		spdlog::info("Orbits: Drawing the first {} bodies only", ORBIT_MAX_TRACKED);
+	if (m_preview.selection.empty())
+		m_preview.selection.assign(tracked.begin(), tracked.begin() + std::min<size_t>(tracked.size(), PREVIEW_MAX_SELECTION));
+	//Perturbers are stepped about their parents, so a moon is only taken once its parent has been
+	for (uint32_t index : tracked)
 	{
-		std::vector<glm::vec2> points = CalculateOrbitPoints(objects[i].position, objects[i].velocity, G, 0.5 * (objects[i].position.x / SCALE));
-		allPoints.insert(allPoints.end(), points.begin(), points.end());
-		m_orbitVertexInfo.offsets.push_back(offset);
-		offset += points.size();
-		m_orbitVertexInfo.vertices.push_back(points.size());
+		if (m_preview.perturbers.size() == PREVIEW_MAX_PERTURBERS)
+			break;
+		uint32_t parent = static_cast<uint32_t>(orbitObjects[index].posOffset.w);
+		if (parent == 0 || std::find(m_preview.perturbers.begin(), m_preview.perturbers.end(), parent) != m_preview.perturbers.end())
+			m_preview.perturbers.push_back(index);
 	}
 
-	//Copy orbit data into its vertex buffer (drawn as lines)
-	vko::Buffer vertexStagingBuffer = CreateBuffer(allPoints.size() * sizeof(glm::vec2), vk::BufferUsageFlagBits::eTransferSrc, allPoints.data());
-	m_orbitVertexInfo.m_bufferVertexOrbit = CreateBuffer(allPoints.size() * sizeof(glm::vec2), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	
-	CopyBuffer(vertexStagingBuffer, m_orbitVertexInfo.m_bufferVertexOrbit, allPoints.size() * sizeof(glm::vec2));
-	vertexStagingBuffer.Destroy();
+	//Indices only, the orbits themselves are derived on the GPU every frame
+	m_orbits.trackedCount = tracked.size();
+	if (!tracked.empty())
+	{
+		vko::Buffer trackedStagingBuffer = CreateBuffer(tracked.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eTransferSrc, tracked.data());
+		m_orbits.trackedBuffer = CreateBuffer(tracked.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		CopyBuffer(trackedStagingBuffer, m_orbits.trackedBuffer, tracked.size() * sizeof(uint32_t));
+		trackedStagingBuffer.Destroy();
+	}
+	instanceStagingBuffer.Destroy();
 }
 
-void OrreyVk::CreateCommandBuffers()
+vk::CommandBuffer OrreyVk::RecordFrame(uint32_t imageIndex)
 {
-	uint32_t swapchainLength = m_vulkanResources->swapchain.GetImageCount();
-	m_vulkanResources->commandBuffers = m_vulkanResources->commandPool.AllocateCommandBuffers(swapchainLength);
-	std::vector<VulkanTools::ImageResources> swapchainImages = m_vulkanResources->swapchain.GetImages();
-	vk::Extent2D swapchainDimensions = m_vulkanResources->swapchain.GetDimensions();
-	for (size_t i = 0; i < swapchainLength; i++)
+	//Recorded again every frame. Each pass goes into its own secondary command buffer on whichever recording thread is free, they run in the order listed
+	vk::Framebuffer framebuffer = m_vulkanResources->frameBuffers[imageIndex];
+	vk::Image swapchainImage = m_vulkanResources->swapchain.GetImages()[imageIndex].image;
+	vk::Rect2D renderArea = vk::Rect2D({ 0, 0 }, m_renderExtent); //Below the swapchain's while the governor has the resolution scaled down
+
+	std::vector<vk::ClearValue> clearValues = {};
+	clearValues.resize(2);
+	clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
+	clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0.0f);
+	vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo(m_vulkanResources->renderpass, framebuffer);
+	renderPassInfo.clearValueCount = 2;
+	renderPassInfo.pClearValues = clearValues.data();
+	renderPassInfo.renderArea = renderArea;
+
+	//With the visibility buffer only ids and depth are drawn until both phases are done
+	vk::RenderPassBeginInfo visibilityPassInfo = vk::RenderPassBeginInfo(m_visibility.renderpass, m_visibility.framebuffer);
+	std::vector<vk::ClearValue> visibilityClearValues = clearValues;
+	visibilityClearValues[0].color = vk::ClearColorValue(std::array<uint32_t, 4>{ 0xFFFFFFFF, 0xFFFFFFFF, 0, 0 });
+	visibilityPassInfo.clearValueCount = 2;
+	visibilityPassInfo.pClearValues = visibilityClearValues.data();
+	visibilityPassInfo.renderArea = renderArea;
+
+	vk::RenderPassBeginInfo loadPassInfo = vk::RenderPassBeginInfo(m_vulkanResources->renderpassLoad, framebuffer);
+	loadPassInfo.renderArea = renderArea;
+
+	std::vector<vko::VulkanCommandRecorder::Pass> passes;
+	passes.push_back({ [this](vk::CommandBuffer cmdBuffer) { RecordFrameStart(cmdBuffer); }, vk::RenderPassBeginInfo() });
+
+	//Draw instanced objects visible last frame
+	passes.push_back({ [this](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindVertexBuffers(0, m_bufferVertex.buffer, { 0 });
+		cmdBuffer.bindIndexBuffer(m_bufferIndex.buffer, { 0 }, vk::IndexType::eUint16);
+		DrawCulledObjects(cmdBuffer, 0);
+	}, m_visibility.enabled ? visibilityPassInfo : renderPassInfo });
+
+	passes.push_back({ [this](vk::CommandBuffer cmdBuffer) { RecordSecondCull(cmdBuffer); }, vk::RenderPassBeginInfo() });
+
+	if (m_visibility.enabled)
+	{
+		//Ids of the objects the first phase missed, then shade every covered pixel once
+		vk::RenderPassBeginInfo visibilityLoadPassInfo = vk::RenderPassBeginInfo(m_visibility.renderpassLoad, m_visibility.framebuffer);
+		visibilityLoadPassInfo.renderArea = renderArea;
+		passes.push_back({ [this](vk::CommandBuffer cmdBuffer) {
+			cmdBuffer.bindVertexBuffers(0, m_bufferVertex.buffer, { 0 });
+			cmdBuffer.bindIndexBuffer(m_bufferIndex.buffer, { 0 }, vk::IndexType::eUint16);
+			DrawCulledObjects(cmdBuffer, 1);
+		}, visibilityLoadPassInfo });
+
+		passes.push_back({ [this, swapchainImage](vk::CommandBuffer cmdBuffer) {
+			InsertImageMemoryBarrier(cmdBuffer, m_visibility.image.image,
+				vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eShaderRead,
+				vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eFragmentShader,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+			InsertImageMemoryBarrier(cmdBuffer, m_vulkanResources->swapchain.GetDepthImage().image,
+				vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal,
+				vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
+			//The first colour pass is skipped, so the swapchain image comes straight from the presentation engine, or the offscreen target from the last post pass
+			vk::Image colourTarget = m_postProcess ? m_vulkanResources->swapchain.GetColourImage().image : swapchainImage;
+			InsertImageMemoryBarrier(cmdBuffer, colourTarget,
+				{}, vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+				vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+		}, vk::RenderPassBeginInfo() });
+
+		passes.push_back({ [this](vk::CommandBuffer cmdBuffer) { ShadeVisibility(cmdBuffer); }, loadPassInfo });
+	}
+	else
 	{
-		std::vector<vk::ClearValue> clearValues = {};
-		clearValues.resize(2);
-		clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
-		clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0.0f);
-		vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo(m_vulkanResources->renderpass, m_vulkanResources->frameBuffers[i]);
-		renderPassInfo.clearValueCount = 2;
-		renderPassInfo.pClearValues = clearValues.data();
-		renderPassInfo.renderArea = vk::Rect2D({ 0, 0 }, swapchainDimensions);
+		//Draw instanced objects the first phase missed
+		passes.push_back({ [this](vk::CommandBuffer cmdBuffer) {
+			cmdBuffer.bindVertexBuffers(0, m_bufferVertex.buffer, { 0 });
+			cmdBuffer.bindIndexBuffer(m_bufferIndex.buffer, { 0 }, vk::IndexType::eUint16);
+			DrawCulledObjects(cmdBuffer, 1);
+		}, loadPassInfo });
+	}
+
+	//The rest of the scene carries on in the same render pass, recorded alongside the objects
+	passes.push_back({ [this](vk::CommandBuffer cmdBuffer) {
+		//Fill in the sky behind the opaque objects, before anything is blended over it
+		DrawSky(cmdBuffer);
 
-		m_vulkanResources->commandBuffers[i].begin(vk::CommandBufferBeginInfo());
+		//Composite the splatted sub-pixel objects, depth tested against the meshes and resolved with them
+		if (m_splat.enabled)
+		{
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_splat.pipeline);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_splat.pipelineLayout, 0, m_splat.descriptorSet, {});
+			cmdBuffer.pushConstants(m_splat.pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t), &m_renderExtent.width);
+			cmdBuffer.draw(3, 1, 0, 0);
+		}
 
-		if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
+		//Blend each ring and belt's annulus over whatever is in front of it, it draws nothing until its members start to fade
+		uint32_t aggregateCount = m_aggregate.populations.size();
+		if (aggregateCount > 0)
 		{
-			InsertBufferMemoryBarrier(m_vulkanResources->commandBuffers[i], m_bufferInstance,
-				{}, vk::AccessFlagBits::eVertexAttributeRead,
-				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
-				m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_aggregate.drawPipeline);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_aggregate.pipelineLayout, 0, m_aggregate.descriptorSet, {});
+			cmdBuffer.draw(AGGREGATE_SEGMENTS * 6, aggregateCount, 0, 0);
 		}
+	}, loadPassInfo, true });
 
-		m_vulkanResources->commandBuffers[i].resetQueryPool(m_queryPool, 0, 2);
-		m_vulkanResources->commandBuffers[i].beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-		
-		//Draw sky sphere
-		m_vulkanResources->commandBuffers[i].bindVertexBuffers(0, m_bufferVertex.buffer, { 0 });
-		m_vulkanResources->commandBuffers[i].bindIndexBuffer(m_bufferIndex.buffer, { 0 }, vk::IndexType::eUint16);
-		m_vulkanResources->commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineSkySphere.pipeline);
-		m_vulkanResources->commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.layout, 0, 1, &m_graphics.skySphereDescriptorSet, 0, nullptr);
-		m_vulkanResources->commandBuffers[i].drawIndexed(m_sphere.GetIndicies().size(), 1, 0, 0, 0);
-
-		//Draw instanced objects
-		m_vulkanResources->commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.pipeline);
-		m_vulkanResources->commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.layout, 0, 1, &m_graphics.descriptorSet, 0, nullptr);
-		m_vulkanResources->commandBuffers[i].bindVertexBuffers(1, m_bufferInstance.buffer, { 0 });
-		m_vulkanResources->commandBuffers[i].writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 0);
-		m_vulkanResources->commandBuffers[i].drawIndexed(m_sphere.GetIndicies().size(), m_bufferInstance.size / sizeof(CelestialObj), 0, 0, 0);
-		m_vulkanResources->commandBuffers[i].writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 1);
-
-		//Draw orbits
-		m_vulkanResources->commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineOrbits.pipeline);	
-		m_vulkanResources->commandBuffers[i].bindVertexBuffers(0, m_orbitVertexInfo.m_bufferVertexOrbit.buffer, { 0 });
-		for (int j = 0; j < m_orbitVertexInfo.vertices.size(); j++)
+	passes.push_back({ [this](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 8);
+		//Nothing bound carries over from the other passes, the orbits use the planets' layout and ubo
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.layout, 0, 1, &m_graphics.descriptorSet, 0, nullptr);
+
+		//Draw orbits, every one of them in a single call sized by orbit.comp
+		if (m_orbits.trackedCount > 0)
 		{
-			m_vulkanResources->commandBuffers[i].draw(m_orbitVertexInfo.vertices[j], 1, m_orbitVertexInfo.offsets[j], 0);
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineOrbits.pipeline);
+			cmdBuffer.bindVertexBuffers(0, m_orbits.vertexBuffer.buffer, { 0 });
+			cmdBuffer.drawIndirect(m_orbits.drawBuffer.buffer, 0, 1, sizeof(vk::DrawIndirectCommand));
 		}
 
-		m_vulkanResources->commandBuffers[i].endRenderPass();
+		//Draw the last finished preview, its vertex count is 0 until there is one
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineOrbits.pipeline);
+		cmdBuffer.bindVertexBuffers(0, m_preview.vertexBuffer.buffer, { 0 });
+		cmdBuffer.drawIndirect(m_preview.drawBuffer.buffer, 0, 1, sizeof(vk::DrawIndirectCommand));
+	}, loadPassInfo, true });
+
+	passes.push_back({ [this, swapchainImage](vk::CommandBuffer cmdBuffer) { RecordFrameEnd(cmdBuffer, swapchainImage); }, vk::RenderPassBeginInfo() });
+
+	return m_vulkanResources->commandRecorder.RecordFrame(m_frameID, passes);
+}
+
+void OrreyVk::RecordFrameStart(vk::CommandBuffer cmdBuffer)
+{
+	if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
+			{}, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
+		InsertBufferMemoryBarrier(cmdBuffer, m_cull.clusterBuffer,
+			{}, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
+	}
+
+	//Orbits are rebuilt from the latest state on the graphics queue, so their buffers never change owner
+	if (m_orbits.trackedCount > 0)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_orbits.drawBuffer,
+			vk::AccessFlagBits::eIndirectCommandRead, vk::AccessFlagBits::eTransferWrite,
+			vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eTransfer,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		cmdBuffer.fillBuffer(m_orbits.drawBuffer.buffer, 0, sizeof(uint32_t), 0);
+		InsertBufferMemoryBarrier(cmdBuffer, m_orbits.drawBuffer,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+		OrbitPush push = { m_orbits.trackedCount, SCALE, ORBIT_TOLERANCE, ORBIT_MAX_SEGMENTS };
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_orbits.pipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_orbits.pipelineLayout, 0, m_orbits.descriptorSet, {});
+		cmdBuffer.pushConstants(m_orbits.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(OrbitPush), &push);
+		cmdBuffer.dispatch(m_orbits.trackedCount, 1, 1); //One workgroup per orbit
+
+		InsertBufferMemoryBarrier(cmdBuffer, m_orbits.drawBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		InsertBufferMemoryBarrier(cmdBuffer, m_orbits.vertexBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eVertexAttributeRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	//Forward preview, a slice of the steps ahead of the selection integrated on cloned state. Does nothing while switched off
+	InsertBufferMemoryBarrier(cmdBuffer, m_preview.stateBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_preview.drawBuffer,
+		vk::AccessFlagBits::eIndirectCommandRead, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_preview.pipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_preview.pipelineLayout, 0, m_preview.descriptorSet, {});
+	cmdBuffer.dispatch(1, 1, 1);
+	InsertBufferMemoryBarrier(cmdBuffer, m_preview.drawBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_preview.vertexBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eVertexAttributeRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+	//Cull the reference system against the view, clusters then objects, and compact the survivors into the instance list.
+	//The first phase draws what was visible last frame, the second tests everything against the depth that left and draws the rest
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.drawBuffer,
+		vk::AccessFlagBits::eIndirectCommandRead, vk::AccessFlagBits::eTransferWrite,
+		vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eTransfer,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	for (uint32_t draw = 0; draw < CULL_BUCKET_COUNT * 2; draw++)
+		cmdBuffer.fillBuffer(m_cull.drawBuffer.buffer, draw * sizeof(vk::DrawIndexedIndirectCommand) + offsetof(vk::DrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), 0);
+	cmdBuffer.fillBuffer(m_cull.statsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.drawBuffer,
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.statsBuffer,
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.visibleBuffer,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.renderBuffer,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.historyBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+	if (m_splat.enabled)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_splat.buffer,
+			vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite,
+			vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		cmdBuffer.fillBuffer(m_splat.buffer.buffer, 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+		InsertBufferMemoryBarrier(cmdBuffer, m_splat.buffer,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	//Rings and belts are placed and faded before either phase reads them, and counted into their bins every so often
+	uint32_t aggregateCount = m_aggregate.populations.size();
+	if (aggregateCount > 0)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_aggregate.buffer,
+			vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		InsertBufferMemoryBarrier(cmdBuffer, m_aggregate.densityBuffer,
+			vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+		AggregatePush aggregatePush = { aggregateCount, static_cast<float>(m_renderExtent.height), AGGREGATE_FADE_PIXEL_SIZE, m_governor.copies };
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_aggregate.pipelines[0]);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_aggregate.pipelineLayout, 0, m_aggregate.descriptorSet, {});
+		cmdBuffer.pushConstants(m_aggregate.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(AggregatePush), &aggregatePush);
+		cmdBuffer.dispatch(aggregateCount * AGGREGATE_BINS / AGGREGATE_GROUP_SIZE, 1, 1);
+
+		InsertBufferMemoryBarrier(cmdBuffer, m_aggregate.densityBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_aggregate.pipelines[1]);
+		cmdBuffer.dispatch((m_aggregate.maxCount + AGGREGATE_GROUP_SIZE - 1) / AGGREGATE_GROUP_SIZE, aggregateCount, 1);
+
+		InsertBufferMemoryBarrier(cmdBuffer, m_aggregate.buffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		InsertBufferMemoryBarrier(cmdBuffer, m_aggregate.densityBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	DispatchCull(cmdBuffer, 0);
+
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.drawBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.visibleBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.renderBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	if (m_splat.enabled)
+		InsertBufferMemoryBarrier(cmdBuffer, m_splat.buffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+	//Queries 0 to 3 belong to the compute queue
+	cmdBuffer.resetQueryPool(m_queryPool, 4, 4 + MULTIVIEW_MAX_VIEWS);
+	cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 4);
+	//Instance draw start, outside the render pass so it is a single query whatever the view count
+	cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 7);
+}
+
+void OrreyVk::DispatchCull(vk::CommandBuffer cmdBuffer, uint32_t phase)
+{
+	//Each copy of the test particles is culled as another pass over the reference system's clusters
+	uint32_t aggregateCount = m_aggregate.populations.size();
+	CullPush cullPush = { m_ensemble.systemSize, CULL_MIN_PIXEL_SIZE, static_cast<float>(m_renderExtent.height), m_governor.lodPixelSize, m_governor.impostorPixelSize, m_renderExtent.width, aggregateCount, m_cull.sectionSize, m_viewCount };
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_cull.pipelines[phase]);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cull.pipelineLayout, 0, m_cull.descriptorSet, {});
+	cmdBuffer.pushConstants(m_cull.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPush), &cullPush);
+	cmdBuffer.dispatch(m_cull.clusterCount * m_governor.copies, 1, 1);
+}
+
+void OrreyVk::RecordSecondCull(vk::CommandBuffer cmdBuffer)
+{
+	//Build the depth pyramid from what the first phase drew, then test everything against it. It only covers one view, several are not occlusion tested
+	if (m_viewCount == 1)
+		BuildOcclusionPyramid(cmdBuffer);
+
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.visibleBuffer,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.renderBuffer,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	DispatchCull(cmdBuffer, 1);
+
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.drawBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.visibleBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.renderBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.statsBuffer,
+		vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+}
+
+void OrreyVk::ShadeVisibility(vk::CommandBuffer cmdBuffer)
+{
+	//The first colour pass was skipped, nothing else clears the target
+	vk::ClearAttachment clearColour = vk::ClearAttachment(vk::ImageAspectFlagBits::eColor, 0, vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+	cmdBuffer.clearAttachments(clearColour, vk::ClearRect(vk::Rect2D({ 0, 0 }, m_renderExtent), 0, 1));
+
+	std::vector<uint32_t> shadePush = { m_renderExtent.width, m_renderExtent.height };
+	for (const SolidSphere::Lod& lod : m_sphere.GetLods())
+	{
+		shadePush.push_back(lod.firstIndex);
+		shadePush.push_back(static_cast<uint32_t>(lod.vertexOffset));
+	}
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_visibility.shadePipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_visibility.shadePipelineLayout, 0, m_visibility.shadeDescriptorSet, {});
+	cmdBuffer.pushConstants(m_visibility.shadePipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, shadePush.size() * sizeof(uint32_t), shadePush.data());
+	cmdBuffer.draw(3, 1, 0, 0);
+}
+
+void OrreyVk::RecordFrameEnd(vk::CommandBuffer cmdBuffer, vk::Image swapchainImage)
+{
+	cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 5);
+
+	if (m_postProcess)
+		PostProcess(cmdBuffer, swapchainImage);
+	cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 6);
+
+	if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
+			vk::AccessFlagBits::eShaderRead, {},
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
+		InsertBufferMemoryBarrier(cmdBuffer, m_cull.clusterBuffer,
+			vk::AccessFlagBits::eShaderRead, {},
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
+	}
+}
+
+void OrreyVk::DrawSky(vk::CommandBuffer cmdBuffer)
+{
+	//A full screen triangle on the far plane, pixels the objects covered fail the depth test before they are shaded
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineSky.pipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.layout, 0, 1, &m_graphics.skyDescriptorSet, 0, nullptr);
+	cmdBuffer.draw(3, 1, 0, 0);
+}
 
-		if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
+void OrreyVk::DrawCulledObjects(vk::CommandBuffer cmdBuffer, uint32_t phase)
+{
+	//Each level of detail then the impostors, only the reference system is drawn, ensemble copies are simulated only
+	vk::DeviceSize firstDraw = phase * CULL_BUCKET_COUNT * sizeof(vk::DrawIndexedIndirectCommand);
+	if (m_visibility.enabled)
+	{
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_visibility.pipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_visibility.pipelineLayout, 0, 1, &m_graphics.descriptorSet, 0, nullptr);
+		for (uint32_t lod = 0; lod < SPHERE_LOD_COUNT; lod++)
 		{
-			InsertBufferMemoryBarrier(m_vulkanResources->commandBuffers[i], m_bufferInstance,
-				vk::AccessFlagBits::eVertexAttributeRead, {},
-				vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader,
-				m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
+			cmdBuffer.pushConstants(m_visibility.pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t), &lod);
+			cmdBuffer.drawIndexedIndirect(m_cull.drawBuffer.buffer, firstDraw + lod * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
 		}
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_visibility.pipelineImpostors);
+		cmdBuffer.drawIndexedIndirect(m_cull.drawBuffer.buffer, firstDraw + SPHERE_LOD_COUNT * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+		return;
+	}
+
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.pipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics.pipelinePlanets.layout, 0, 1, &m_graphics.descriptorSet, 0, nullptr);
+	for (uint32_t lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+		cmdBuffer.drawIndexedIndirect(m_cull.drawBuffer.buffer, firstDraw + lod * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics.pipelineImpostors.pipeline);
+	cmdBuffer.drawIndexedIndirect(m_cull.drawBuffer.buffer, firstDraw + SPHERE_LOD_COUNT * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+}
 
-		m_vulkanResources->commandBuffers[i].end();
+void OrreyVk::BuildOcclusionPyramid(vk::CommandBuffer cmdBuffer)
+{
+	vk::Image depthImage = m_vulkanResources->swapchain.GetDepthImage().image;
+	vk::ImageSubresourceRange depthRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1);
+	vk::ImageSubresourceRange pyramidRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, m_hiz.levels, 0, 1);
+
+	InsertImageMemoryBarrier(cmdBuffer, depthImage,
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eShaderRead,
+		vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+		vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader,
+		depthRange);
+	//Last frame's second phase has to finish reading before every level is rebuilt
+	InsertImageMemoryBarrier(cmdBuffer, m_hiz.pyramid.image,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+		vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		pyramidRange);
+
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_hiz.pipeline);
+	for (uint32_t level = 0; level < m_hiz.levels; level++)
+	{
+		uint32_t width = std::max(m_hiz.pyramid.extent.width >> level, 1u);
+		uint32_t height = std::max(m_hiz.pyramid.extent.height >> level, 1u);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_hiz.pipelineLayout, 0, m_hiz.descriptorSets[level], {});
+		cmdBuffer.pushConstants(m_hiz.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &level);
+		cmdBuffer.dispatch((width + 7) / 8, (height + 7) / 8, 1);
+
+		InsertImageMemoryBarrier(cmdBuffer, m_hiz.pyramid.image,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
 	}
+
+	InsertImageMemoryBarrier(cmdBuffer, depthImage,
+		vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+		vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+		depthRange);
 }
 
 void OrreyVk::CreateDescriptorPool()
 {
 	std::vector<vk::DescriptorPoolSize> poolSizes =
 	{
-		vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 3),
-		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1),
-		vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 2)
+		vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 7),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 35),
+		vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 11 + HIZ_MAX_LEVELS),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 2 + 2 * HIZ_MAX_LEVELS)
 	};
 
-	vk::DescriptorPoolCreateInfo poolInfo = vk::DescriptorPoolCreateInfo({}, 6, poolSizes.size(), poolSizes.data());
+	vk::DescriptorPoolCreateInfo poolInfo = vk::DescriptorPoolCreateInfo({}, 14 + HIZ_MAX_LEVELS, poolSizes.size(), poolSizes.data());
 	m_vulkanResources->descriptorPool = m_vulkanResources->device.createDescriptorPool(poolInfo);
 }
 
@@ -334,6 +887,8 @@ void OrreyVk::CreateDescriptorSetLayout()
 {
 	std::vector<vk::DescriptorSetLayoutBinding> layoutBindings =
 	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
 		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex),
 		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment)
 	};
@@ -347,15 +902,18 @@ void OrreyVk::CreateDescriptorSet()
 	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 2, layouts);
 	std::vector<vk::DescriptorSet> sets = m_vulkanResources->device.allocateDescriptorSets(allocInfo);
 	m_graphics.descriptorSet = sets[0];
-	m_graphics.skySphereDescriptorSet = sets[1];
+	m_graphics.skyDescriptorSet = sets[1];
 
+	//The sky never reads the instances, its set leaves 0 and 1 empty
 	std::vector<vk::WriteDescriptorSet> writeSets =
 	{
+		vk::WriteDescriptorSet(m_graphics.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.renderBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_graphics.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.visibleBuffer.descriptor)),
 		vk::WriteDescriptorSet(m_graphics.descriptorSet, 2, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
 		vk::WriteDescriptorSet(m_graphics.descriptorSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureArrayPlanets.descriptor), {}),
 
-		vk::WriteDescriptorSet(m_graphics.skySphereDescriptorSet, 2, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
-		vk::WriteDescriptorSet(m_graphics.skySphereDescriptorSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureStarfield.descriptor), {})
+		vk::WriteDescriptorSet(m_graphics.skyDescriptorSet, 2, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_graphics.skyDescriptorSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureStarfield.descriptor), {})
 	};
 
 	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
@@ -376,23 +934,16 @@ void OrreyVk::CreateGraphicsPipeline()
 	vk::PipelineShaderStageCreateInfo fragShaderStage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
 	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStage, fragShaderStage };
 
+	//Instances are fetched by planets.vert from the storage buffers, through the list cull.comp compacted
 	std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions = m_sphere.GetVertexAttributeDescription();
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, position)));
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(4, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, posOffset)));
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(5, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, scale)));
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(6, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, rotation)));
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(7, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, orbitalTilt)));
-	vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription(8, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(CelestialObj, colourTint)));
-
 	std::vector<vk::VertexInputBindingDescription> bindingDesc = { m_sphere.GetVertexBindingDescription() };
-	bindingDesc.push_back(vk::VertexInputBindingDescription(1, sizeof(CelestialObj), vk::VertexInputRate::eInstance));
 
-	vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo({}, 2, bindingDesc.data(), vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo({}, 1, bindingDesc.data(), vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
 
 	vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo({}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
 
-	vk::Viewport viewport = vk::Viewport(0.0, 0.0, m_vulkanResources->swapchain.GetDimensions().width, m_vulkanResources->swapchain.GetDimensions().height, 0.0, 1.0);
-	vk::Rect2D scissor = vk::Rect2D({ 0,0 }, m_vulkanResources->swapchain.GetDimensions());
+	vk::Viewport viewport = vk::Viewport(0.0, 0.0, m_renderExtent.width, m_renderExtent.height, 0.0, 1.0);
+	vk::Rect2D scissor = vk::Rect2D({ 0,0 }, m_renderExtent);
 	vk::PipelineViewportStateCreateInfo viewPortState = vk::PipelineViewportStateCreateInfo({}, 1, &viewport, 1, &scissor);
 
 	vk::PipelineRasterizationStateCreateInfo rastierizer = vk::PipelineRasterizationStateCreateInfo();
@@ -430,9 +981,9 @@ void OrreyVk::CreateGraphicsPipeline()
 	m_graphics.pipelinePlanets.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
 
 	//Orbit pipeline - Uses same layout as planets(ubo, texture array)- we just don't access the array in the fragment shader
-	inputAssembly.topology = vk::PrimitiveTopology::eLineStrip;
-	vertexAttributeDescriptions = { vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32Sfloat, 0) }; //Change vertex input
-	bindingDesc = { vk::VertexInputBindingDescription(0, sizeof(glm::vec2)) };
+	inputAssembly.topology = vk::PrimitiveTopology::eLineList;
+	vertexAttributeDescriptions = { vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32A32Sfloat, 0) }; //Change vertex input
+	bindingDesc = { vk::VertexInputBindingDescription(0, sizeof(glm::vec4)) };
 	vertexInputInfo = vk::PipelineVertexInputStateCreateInfo({}, 1, bindingDesc.data(), vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
 	vertShader = CompileShader("resources/shaders/orbit.vert.spv"); //Change shaders
 	fragShader = CompileShader("resources/shaders/orbit.frag.spv");
@@ -440,19 +991,35 @@ void OrreyVk::CreateGraphicsPipeline()
 	shaderStages[1] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
 	m_graphics.pipelineOrbits.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
 
-	//Skysphere Pipeline
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+
+	//Impostor pipeline - Same inputs as the planets, only the quad corners are read. The quad always faces the camera so nothing is culled
 	inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
 	vertexAttributeDescriptions = m_sphere.GetVertexAttributeDescription();
-	vertShader = CompileShader("resources/shaders/skysphere.vert.spv");
-	fragShader = CompileShader("resources/shaders/skysphere.frag.spv");
-	shaderStages[0] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main");
-	shaderStages[1] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
-	rastierizer.frontFace = vk::FrontFace::eCounterClockwise; //So we can see the texture from inside the sphere
 	bindingDesc = { m_sphere.GetVertexBindingDescription() };
 	vertexInputInfo = vk::PipelineVertexInputStateCreateInfo({}, 1, bindingDesc.data(), vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
+	vertShader = CompileShader("resources/shaders/impostor.vert.spv");
+	fragShader = CompileShader("resources/shaders/impostor.frag.spv");
+	shaderStages[0] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main");
+	shaderStages[1] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
+	rastierizer.cullMode = vk::CullModeFlagBits::eNone;
+
+	m_graphics.pipelineImpostors.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
+
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+
+	//Sky pipeline - One triangle on the far plane with no vertex input, tested against the depth the objects left but never writing it
+	vertShader = CompileShader("resources/shaders/sky.vert.spv");
+	fragShader = CompileShader("resources/shaders/sky.frag.spv");
+	shaderStages[0] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main");
+	shaderStages[1] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
+	vertexInputInfo = vk::PipelineVertexInputStateCreateInfo();
+	depthStencilInfo = vk::PipelineDepthStencilStateCreateInfo({}, VK_TRUE, VK_FALSE, vk::CompareOp::eLessOrEqual);
+
+	m_graphics.pipelineSky.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
 
-	m_graphics.pipelineSkySphere.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
-	
 	m_vulkanResources->device.destroyShaderModule(vertShader);
 	m_vulkanResources->device.destroyShaderModule(fragShader);
 }
@@ -463,7 +1030,7 @@ void OrreyVk::RenderFrame()
 
 	vk::Semaphore waitSemaphores[] = { m_compute.semaphore, m_vulkanResources->semaphoreImageAquired[m_frameID]  };
 	vk::Semaphore signalSemaphores[] = { m_graphics.semaphore, m_vulkanResources->semaphoreRender[m_frameID] };
-	vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eColorAttachmentOutput };
+	vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eColorAttachmentOutput };
 
 	vk::SubmitInfo submitInfo = vk::SubmitInfo();
 	submitInfo.waitSemaphoreCount = 2;
@@ -471,8 +1038,9 @@ void OrreyVk::RenderFrame()
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.signalSemaphoreCount = 2;
 	submitInfo.pSignalSemaphores = signalSemaphores;
+	vk::CommandBuffer cmdBuffer = RecordFrame(imageIndex.value);
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_vulkanResources->commandBuffers[imageIndex.value];
+	submitInfo.pCommandBuffers = &cmdBuffer;
 
 	m_vulkanResources->queueGraphics.submit(submitInfo, nullptr);
 
@@ -482,7 +1050,7 @@ void OrreyVk::RenderFrame()
 	vk::Result result = m_vulkanResources->queueGraphics.presentKHR(presentInfo);
 	m_vulkanResources->queueGraphics.waitIdle();
 
-	//spdlog::info("\Instance draw time = {}ms", GetTimeQueryResult(m_queueIDs.graphics.timestampValidBits));
+	//spdlog::info("\Instance draw time = {}ms", GetTimeQueryResult(m_queueIDs.graphics.timestampValidBits, 7));
 
 	vk::SubmitInfo computeSubmitInfo = vk::SubmitInfo();
 	computeSubmitInfo.waitSemaphoreCount = 1;
@@ -494,7 +1062,93 @@ void OrreyVk::RenderFrame()
 	computeSubmitInfo.commandBufferCount = 1;
 	computeSubmitInfo.pCommandBuffers = &m_compute.cmdBuffer;
 
-	m_vulkanResources->queueCompute.submit(computeSubmitInfo, nullptr);
+	m_vulkanResources->device.waitForFences(m_compute.fence, true, UINT64_MAX);
+	m_vulkanResources->device.resetFences(m_compute.fence);
+
+	//Every substep is a step of its own, a keyframe is taken before the frame whose steps cross the interval
+	if (!m_timeline.keyframes.empty() && !m_timeline.seekPending && m_timeline.step % KEYFRAME_STEP_INTERVAL < m_governor.substeps)
+	{
+		//Skip a keyframe a seek has just landed on
+		const KeyframeInfo& previous = m_timeline.keyframes[(m_timeline.nextSlot + m_timeline.keyframes.size() - 1) % m_timeline.keyframes.size()];
+		if (!previous.valid || previous.step != m_timeline.step)
+			m_timeline.captureSlot = m_timeline.nextSlot;
+	}
+
+	//A snapshot is taken after the frame whose steps cross the interval, however many substeps it has
+	if (m_recording.recorder && !m_timeline.seekPending && (m_timeline.step + m_governor.substeps) % RECORD_STEP_INTERVAL < m_governor.substeps)
+	{
+		RecordSlot& slot = m_recording.slots[m_recording.nextSlot];
+		if (slot.inFlight || slot.writing)
+			m_recording.dropped++;
+		else
+		{
+			m_recording.pendingSlot = m_recording.nextSlot;
+			m_recording.nextSlot = (m_recording.nextSlot + 1) % RECORD_RING_SIZE;
+		}
+	}
+
+	//Record again when the last step carried one off work, or there is new work to add
+	if (m_compute.rerecord || m_checkpoint.state == CheckpointState::eRequested || m_recording.pendingSlot >= 0 || m_timeline.captureSlot >= 0 || m_timeline.seekPending)
+	{
+		m_compute.rerecord = false;
+		m_compute.cmdBuffer.reset({});
+		CreateComputeCommandBuffer();
+	}
+
+	m_vulkanResources->queueCompute.submit(computeSubmitInfo, m_compute.fence);
+	m_compute.submitCount++;
+
+	if (m_timeline.captureSlot >= 0)
+	{
+		KeyframeInfo& keyframe = m_timeline.keyframes[m_timeline.captureSlot];
+		keyframe.valid = true;
+		keyframe.step = m_timeline.step;
+		keyframe.simulationTime = m_simulationTime;
+		m_timeline.nextSlot = (m_timeline.captureSlot + 1) % m_timeline.keyframes.size();
+		m_timeline.captureSubmitIndex = m_compute.submitCount;
+		m_timeline.captureSlot = -1;
+
+		//Step times older than the oldest keyframe can no longer be replayed
+		uint64_t oldestStep = keyframe.step;
+		for (const KeyframeInfo& info : m_timeline.keyframes)
+			if (info.valid)
+				oldestStep = std::min(oldestStep, info.step);
+		while (m_timeline.firstStep < oldestStep)
+		{
+			m_timeline.stepTimes.pop_front();
+			m_timeline.firstStep++;
+		}
+	}
+
+	//A seek restores and fast forwards instead of stepping, its time was set by Seek
+	if (m_timeline.seekPending)
+		m_timeline.seekPending = false;
+	else
+	{
+		for (uint32_t substep = 0; substep < m_governor.substeps; substep++)
+		{
+			m_timeline.stepTimes.push_back(m_compute.ubo.deltaT * m_compute.ubo.speed);
+			m_timeline.step++;
+			m_simulationTime += m_compute.ubo.deltaT * m_compute.ubo.speed;
+		}
+	}
+
+	if (m_checkpoint.state == CheckpointState::eRecorded)
+	{
+		m_checkpoint.header.simulationTime = m_simulationTime;
+		m_checkpoint.submitIndex = m_compute.submitCount;
+		m_checkpoint.state = CheckpointState::eInFlight;
+	}
+
+	if (m_recording.pendingSlot >= 0)
+	{
+		RecordSlot& slot = m_recording.slots[m_recording.pendingSlot];
+		slot.inFlight = true;
+		slot.submitIndex = m_compute.submitCount;
+		slot.step = m_timeline.step;
+		slot.simulationTime = m_simulationTime;
+		m_recording.pendingSlot = -1;
+	}
 
 	//spdlog::info("\Compute time = {}ms", GetTimeQueryResult(m_queueIDs.compute.timestampValidBits));
 
@@ -518,15 +1172,32 @@ void OrreyVk::UpdateCameraUniformBuffer()
 	m_graphics.ubo.view = glm::rotate(m_graphics.ubo.view, glm::radians(m_camera.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
 	m_graphics.ubo.view = glm::rotate(m_graphics.ubo.view, glm::radians(m_camera.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 	m_graphics.ubo.view = glm::rotate(m_graphics.ubo.view, glm::radians(m_camera.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	m_graphics.ubo.viewProjection = m_graphics.ubo.projection * m_graphics.ubo.view * m_graphics.ubo.model;
+	UpdateViews();
 
 	memcpy(m_graphics.uniformBuffer.mapped, &m_graphics.ubo, sizeof(m_graphics.ubo));
 
 	m_camera.viewUpdated = false;
 }
 
+void OrreyVk::UpdateViews()
+{
+	//Spread either side of the camera, turned a view's width apart to tile a wall of displays or moved apart for a stereo rig. One view is the camera
+	float fieldOfViewX = 2.0f * std::atan(1.0f / m_graphics.ubo.projection[0][0]);
+	for (uint32_t i = 0; i < m_viewCount; i++)
+	{
+		float offset = i - (m_viewCount - 1) * 0.5f;
+		glm::mat4 viewOffset = m_multiview.eyeSeparation > 0.0f ?
+			glm::translate(glm::mat4(1.0f), glm::vec3(-offset * m_multiview.eyeSeparation, 0.0f, 0.0f)) :
+			glm::rotate(glm::mat4(1.0f), offset * fieldOfViewX, glm::vec3(0.0f, 1.0f, 0.0f));
+		m_graphics.ubo.views[i].view = viewOffset * m_graphics.ubo.view;
+		m_graphics.ubo.views[i].viewProjection = m_graphics.ubo.projection * m_graphics.ubo.views[i].view * m_graphics.ubo.model;
+	}
+}
+
 void OrreyVk::UpdateComputeUniformBuffer()
 {
-	m_compute.ubo.deltaT = m_frameTime;
+	m_compute.ubo.deltaT = m_frameTime / m_governor.substeps;
 	if (m_speed < 0)
 		m_speed = 0;
 	if (m_speed > 300)
@@ -541,18 +1212,32 @@ void OrreyVk::PrepareCompute()
 	m_compute.uniformBuffer = CreateBuffer(sizeof(m_compute.ubo), vk::BufferUsageFlagBits::eUniformBuffer);
 	m_compute.ubo.objectCount = m_bufferInstance.size / sizeof(CelestialObj);
 	m_compute.ubo.scale = SCALE;
+	m_compute.ubo.systemSize = m_ensemble.systemSize;
+	m_compute.ubo.systemCount = m_ensemble.systemCount;
 	m_compute.uniformBuffer.Map();
 	UpdateComputeUniformBuffer();
 
+	//Per system diagnostics, written by the compute queue every step and read back by the host
+	m_ensemble.diagnosticsBuffer = CreateBuffer(m_ensemble.systemCount * sizeof(SystemDiagnostics), vk::BufferUsageFlagBits::eStorageBuffer);
+	m_ensemble.diagnosticsBuffer.Map();
+
+	PrepareTimeline();
+
 	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
 	{
 		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
-		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute) //Written by ToggleRecording once there is something to pack into
 	};
 
 	m_compute.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
 
-	m_compute.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_compute.descriptorSetLayout));
+	//Push constants carry the fast forward step time for planets.comp, the keyframe offset for keyframe.comp and the population for populate.comp
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(sim::PopulationParams));
+	m_compute.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_compute.descriptorSetLayout, 1, &pushConstantRange));
 
 	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_compute.descriptorSetLayout);
 	m_compute.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
@@ -560,7 +1245,10 @@ void OrreyVk::PrepareCompute()
 	std::vector<vk::WriteDescriptorSet> writeSets =
 	{
 		vk::WriteDescriptorSet(m_compute.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferInstance.descriptor)),
-		vk::WriteDescriptorSet(m_compute.descriptorSet, 1, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_compute.uniformBuffer.descriptor))
+		vk::WriteDescriptorSet(m_compute.descriptorSet, 1, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_compute.uniformBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_compute.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_ensemble.diagnosticsBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_compute.descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_timeline.ringBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_compute.descriptorSet, 4, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.clusterBuffer.descriptor))
 	};
 
 	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
@@ -578,10 +1266,45 @@ void OrreyVk::PrepareCompute()
 	pipelineCreateInfo.stage = computeShaderStage;
 	m_compute.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
 
+	//Diagnostics pipeline - one workgroup reduces one system
+	vk::ShaderModule diagnosticsShader = CompileShader("resources/shaders/diagnostics.comp.spv");
+	uint32_t diagnosticsGroupSize = DIAGNOSTICS_GROUP_SIZE;
+	vk::SpecializationInfo diagnosticsSpecInfo = vk::SpecializationInfo(1, &specEntry, sizeof(uint32_t), &diagnosticsGroupSize);
+	computeShaderStage.module = diagnosticsShader;
+	computeShaderStage.pSpecializationInfo = &diagnosticsSpecInfo;
+	pipelineCreateInfo.stage = computeShaderStage;
+	m_ensemble.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	//Keyframe pipeline - packs the instance buffer into the ring or restores it from there
+	vk::ShaderModule keyframeShader = CompileShader("resources/shaders/keyframe.comp.spv");
+	computeShaderStage.module = keyframeShader;
+	computeShaderStage.pSpecializationInfo = &specInfo;
+	pipelineCreateInfo.stage = computeShaderStage;
+	m_timeline.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	m_vulkanResources->device.destroyShaderModule(computeShader);
+	m_vulkanResources->device.destroyShaderModule(diagnosticsShader);
+	//Population pipeline - generates ring and belt members in place
+	vk::ShaderModule populateShader = CompileShader("resources/shaders/populate.comp.spv");
+	computeShaderStage.module = populateShader;
+	pipelineCreateInfo.stage = computeShaderStage;
+	m_population.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	//Recording pipeline - packs every position for a trajectory snapshot
+	vk::ShaderModule recordShader = CompileShader("resources/shaders/record.comp.spv");
+	computeShaderStage.module = recordShader;
+	pipelineCreateInfo.stage = computeShaderStage;
+	m_recording.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	m_vulkanResources->device.destroyShaderModule(keyframeShader);
+	m_vulkanResources->device.destroyShaderModule(populateShader);
+	m_vulkanResources->device.destroyShaderModule(recordShader);
+
 	m_compute.commandPool = vko::VulkanCommandPool(m_vulkanResources->device, m_queueIDs.compute.familyID, vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
 	m_compute.cmdBuffer = m_compute.commandPool.AllocateCommandBuffer();
 
 	m_compute.semaphore = m_vulkanResources->device.createSemaphore(vk::SemaphoreCreateInfo());
+	m_compute.fence = m_vulkanResources->device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
 	vk::SubmitInfo submitInfo = vk::SubmitInfo();
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = &m_compute.semaphore;
@@ -590,31 +1313,95 @@ void OrreyVk::PrepareCompute()
 
 	CreateComputeCommandBuffer();
 
-	if (m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID)
-	{
-		vk::CommandBuffer cmdBuffer = m_compute.commandPool.AllocateCommandBuffer();
-		cmdBuffer.begin(vk::CommandBufferBeginInfo());
+	//One off setup on the compute queue, the starting cluster bounds, populations and the first ownership transfer
+	bool transferOwnership = m_queueIDs.graphics.familyID != m_queueIDs.compute.familyID;
+	auto tStart = std::chrono::high_resolution_clock::now();
+	vk::CommandBuffer cmdBuffer = m_compute.commandPool.AllocateCommandBuffer();
+	cmdBuffer.begin(vk::CommandBufferBeginInfo());
 
+	if (transferOwnership)
+	{
 		InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
 			{}, vk::AccessFlagBits::eShaderWrite,
 			vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader,
 			m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
+	}
+
+	//NaN bounds are never culled, so the first frame draws everything until planets.comp has written real ones
+	cmdBuffer.fillBuffer(m_cull.clusterBuffer.buffer, 0, VK_WHOLE_SIZE, 0x7FC00000);
+	InsertBufferMemoryBarrier(cmdBuffer, m_cull.clusterBuffer,
+		vk::AccessFlagBits::eTransferWrite, transferOwnership ? vk::AccessFlags() : vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		transferOwnership ? m_queueIDs.compute.familyID : VK_QUEUE_FAMILY_IGNORED, transferOwnership ? m_queueIDs.graphics.familyID : VK_QUEUE_FAMILY_IGNORED);
+
+	//Populations are generated where they are simulated, nothing is uploaded for them
+	uint32_t populationObjectCount = 0;
+	if (!m_population.pending.empty())
+	{
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_population.pipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_compute.pipelineLayout, 0, m_compute.descriptorSet, {});
+		for (const sim::PopulationParams& params : m_population.pending)
+		{
+			cmdBuffer.pushConstants(m_compute.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(sim::PopulationParams), &params);
+			cmdBuffer.dispatch((params.count + OBJECTS_PER_GROUP - 1) / OBJECTS_PER_GROUP, 1, 1);
+			populationObjectCount += params.count;
+		}
+
+		if (!transferOwnership)
+		{
+			InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eVertexAttributeRead,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexInput,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		}
+	}
+
+	//The energy and momentum each system drifts from, before the first step has moved anything
+	if (m_ensemble.systemCount > 1)
+	{
+		InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_ensemble.pipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_compute.pipelineLayout, 0, m_compute.descriptorSet, {});
+		cmdBuffer.dispatch(m_ensemble.systemCount, 1, 1);
+		InsertBufferMemoryBarrier(cmdBuffer, m_ensemble.diagnosticsBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
 
+	if (transferOwnership)
+	{
 		InsertBufferMemoryBarrier(cmdBuffer, m_bufferInstance,
 			vk::AccessFlagBits::eShaderWrite, {},
 			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
 			m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
+	}
+
+	cmdBuffer.end();
+
+	submitInfo = vk::SubmitInfo();
+	vk::Fence fence = m_vulkanResources->device.createFence(vk::FenceCreateInfo());
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+	m_vulkanResources->queueCompute.submit(submitInfo, fence);
+	m_vulkanResources->device.waitForFences(fence, true, UINT64_MAX);
+	m_vulkanResources->device.destroyFence(fence);
+	m_compute.commandPool.FreeCommandBuffers(cmdBuffer);
 
-		cmdBuffer.end();
+	if (m_ensemble.systemCount > 1)
+	{
+		m_ensemble.initialDiagnostics.resize(m_ensemble.systemCount);
+		memcpy(m_ensemble.initialDiagnostics.data(), m_ensemble.diagnosticsBuffer.mapped, m_ensemble.systemCount * sizeof(SystemDiagnostics));
+	}
 
-		vk::SubmitInfo submitInfo = vk::SubmitInfo();
-		vk::Fence fence = m_vulkanResources->device.createFence(vk::FenceCreateInfo());
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &cmdBuffer;
-		m_vulkanResources->queueCompute.submit(submitInfo, fence);
-		m_vulkanResources->device.waitForFences(fence, true, INT_MAX);
-		m_vulkanResources->device.destroyFence(fence);
-		m_compute.commandPool.FreeCommandBuffers(cmdBuffer);
+	if (!m_population.pending.empty())
+	{
+		spdlog::info("Scenario: Generated {} objects in {} populations on the GPU in {}ms", populationObjectCount, m_population.pending.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+		m_population.pending.clear();
 	}
 }
 
@@ -626,56 +1413,1868 @@ void OrreyVk::CreateComputeCommandBuffer()
 		{}, vk::AccessFlagBits::eShaderWrite,
 		vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader,
 		m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
+	InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_cull.clusterBuffer,
+		{}, vk::AccessFlagBits::eShaderWrite,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		m_queueIDs.graphics.familyID, m_queueIDs.compute.familyID);
 	
-	m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_compute.pipeline);
 	m_compute.cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_compute.pipelineLayout, 0, m_compute.descriptorSet, {});
-	m_compute.cmdBuffer.resetQueryPool(m_queryPool, 0, 2);
-	m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 0);
-	m_compute.cmdBuffer.dispatch(ceil((m_bufferInstance.size / sizeof(CelestialObj)) / OBJECTS_PER_GROUP), 1, 1);
-	m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 1);
+	uint32_t groupCount = (m_compute.ubo.objectCount + OBJECTS_PER_GROUP - 1) / OBJECTS_PER_GROUP;
+
+	if (m_timeline.seekPending)
+	{
+		//Restore the keyframe then replay the recorded steps up to the seek time, all in this submit
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_timeline.ringBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		uint32_t keyframePush[] = { static_cast<uint32_t>(m_timeline.seekSlot * m_timeline.keyframeSize / sizeof(uint32_t)), 1 };
+		m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_timeline.pipeline);
+		m_compute.cmdBuffer.pushConstants(m_compute.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(keyframePush), keyframePush);
+		m_compute.cmdBuffer.dispatch(groupCount, 1, 1);
+
+		m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_compute.pipeline);
+		m_compute.cmdBuffer.resetQueryPool(m_queryPool, 0, 2);
+		m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 0);
+		for (float stepTime : m_timeline.seekSteps)
+		{
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			m_compute.cmdBuffer.pushConstants(m_compute.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &stepTime);
+			m_compute.cmdBuffer.dispatch(groupCount, 1, 1);
+		}
+		m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 1);
+		m_compute.rerecord = true;
+	}
+	else
+	{
+		if (m_timeline.captureSlot >= 0)
+		{
+			//Pack the state before this step into the ring, once any earlier restore has finished reading the slot
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_timeline.ringBuffer,
+				vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			uint32_t keyframePush[] = { static_cast<uint32_t>(m_timeline.captureSlot * m_timeline.keyframeSize / sizeof(uint32_t)), 0 };
+			m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_timeline.pipeline);
+			m_compute.cmdBuffer.pushConstants(m_compute.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(keyframePush), keyframePush);
+			m_compute.cmdBuffer.resetQueryPool(m_queryPool, 2, 2);
+			m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 2);
+			m_compute.cmdBuffer.dispatch(groupCount, 1, 1);
+			m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 3);
+
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_timeline.ringBuffer,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+				vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			m_compute.rerecord = true;
+		}
+
+		//The frame's time is split over the substeps, each one a step of deltaT * speed from the uniform buffer
+		float stepTime = -1.0f;
+		m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_compute.pipeline);
+		m_compute.cmdBuffer.pushConstants(m_compute.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &stepTime);
+		m_compute.cmdBuffer.resetQueryPool(m_queryPool, 0, 2);
+		m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 0);
+		for (uint32_t substep = 0; substep < m_governor.substeps; substep++)
+		{
+			if (substep > 0)
+				InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+					vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+					vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			m_compute.cmdBuffer.dispatch(groupCount, 1, 1);
+		}
+		m_compute.cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 1);
+	}
+
+	//Energy and momentum of each system, read back by the host every report. A single system has nothing to compare against
+	if (m_ensemble.systemCount > 1)
+	{
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+		m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_ensemble.pipeline);
+		m_compute.cmdBuffer.dispatch(m_ensemble.systemCount, 1, 1);
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_ensemble.diagnosticsBuffer,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	//Readbacks, copied while the compute queue still owns the instance buffer
+	if (m_checkpoint.state == CheckpointState::eRequested || m_recording.pendingSlot >= 0)
+	{
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	if (m_checkpoint.state == CheckpointState::eRequested)
+	{
+		m_compute.cmdBuffer.copyBuffer(m_bufferInstance.buffer, m_checkpoint.readbackBuffer.buffer, vk::BufferCopy(0, 0, m_bufferInstance.size));
+
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_checkpoint.readbackBuffer,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+		m_checkpoint.state = CheckpointState::eRecorded;
+		m_compute.rerecord = true;
+	}
+
+	if (m_recording.pendingSlot >= 0)
+	{
+		//Positions only. Packed on the GPU when recording everything, one copy per body is only worth it for a handful of them
+		RecordSlot& slot = m_recording.slots[m_recording.pendingSlot];
+		if (m_recording.selection.empty())
+		{
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			m_compute.cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_recording.pipeline);
+			m_compute.cmdBuffer.dispatch(groupCount, 1, 1);
+			InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_recording.packedBuffer,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+			m_compute.cmdBuffer.copyBuffer(m_recording.packedBuffer.buffer, slot.buffer.buffer, vk::BufferCopy(0, 0, slot.buffer.size));
+		}
+		else
+		{
+			std::vector<vk::BufferCopy> regions;
+			for (size_t i = 0; i < m_recording.selection.size(); i++)
+				regions.emplace_back(m_recording.selection[i] * sizeof(CelestialObj) + offsetof(CelestialObj, position), i * sizeof(glm::vec4), sizeof(glm::vec4));
+			m_compute.cmdBuffer.copyBuffer(m_bufferInstance.buffer, slot.buffer.buffer, regions);
+		}
+
+		InsertBufferMemoryBarrier(m_compute.cmdBuffer, slot.buffer,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+
+		m_compute.rerecord = true;
+	}
 
 	InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_bufferInstance,
 		vk::AccessFlagBits::eShaderWrite, {},
 		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
 		m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
+	InsertBufferMemoryBarrier(m_compute.cmdBuffer, m_cull.clusterBuffer,
+		vk::AccessFlagBits::eShaderWrite, {},
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		m_queueIDs.compute.familyID, m_queueIDs.graphics.familyID);
 
 	m_compute.cmdBuffer.end();
 }
 
-std::vector<glm::vec2> OrreyVk::CalculateOrbitPoints(glm::vec4 pos, glm::vec4 vel, double G, float timestep)
+void OrreyVk::PrepareSky()
 {
-	int plotPoints = ceil(400 / timestep) * pos.x; //This seems to work quite well
-	glm::vec3 vPos = glm::vec3(pos.x, pos.y, pos.z);
-	float xT = vPos.x / SCALE;
-	float yT = vPos.y / SCALE;
-	float zT = vPos.z / SCALE;
+	//The equirectangular image is only read once to build the cubemap. A face a quarter of its width keeps the texel density it has around the equator
+	vko::Image equirect = CreateTexture(vk::ImageType::e2D, vk::Format::eR8G8B8A8Srgb, "resources/starsmilkyway8k.jpg", vk::ImageUsageFlagBits::eSampled, false);
+	uint32_t faceSize = equirect.extent.width / 4;
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+
+	//Stored sRGB so the mips are filtered linear. sRGB formats can not be storage images, sky.comp writes through a unorm view and encodes itself
+	vk::ImageCreateInfo createInfo = vk::ImageCreateInfo(vk::ImageCreateFlagBits::eCubeCompatible | vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage,
+		vk::ImageType::e2D, vk::Format::eR8G8B8A8Srgb, vk::Extent3D(faceSize, faceSize, 1), mipLevels, 6, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+	vk::Image image = m_vulkanResources->device.createImage(createInfo);
+	vk::MemoryAllocateInfo allocInfo;
+	vk::DeviceMemory imageMemory = AllocateAndBindMemory(image, vk::MemoryPropertyFlagBits::eDeviceLocal, &allocInfo);
+
+	vk::ImageViewUsageCreateInfo storageUsage = vk::ImageViewUsageCreateInfo(vk::ImageUsageFlagBits::eStorage);
+	vk::ImageViewCreateInfo viewCreateInfo = vk::ImageViewCreateInfo({}, image, vk::ImageViewType::e2DArray, vk::Format::eR8G8B8A8Unorm);
+	viewCreateInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 6);
+	viewCreateInfo.setPNext(&storageUsage);
+	vk::ImageView storageView = m_vulkanResources->device.createImageView(viewCreateInfo);
+
+	vk::ImageViewUsageCreateInfo sampledUsage = vk::ImageViewUsageCreateInfo(vk::ImageUsageFlagBits::eSampled);
+	viewCreateInfo = vk::ImageViewCreateInfo({}, image, vk::ImageViewType::eCube, vk::Format::eR8G8B8A8Srgb);
+	viewCreateInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 6);
+	viewCreateInfo.setPNext(&sampledUsage);
+	vk::ImageView cubeView = m_vulkanResources->device.createImageView(viewCreateInfo);
+
+	m_textureStarfield = vko::Image(m_vulkanResources->device, m_vulkanResources->physicalDevice, image, cubeView, imageMemory, allocInfo.allocationSize, createInfo.extent, mipLevels,
+		vk::ImageLayout::eUndefined, createInfo.usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+	vk::DescriptorSetLayout descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+	vk::PipelineLayout pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &descriptorSetLayout));
 
-	float xV = vel.x;
-	float zV = vel.z;
-	std::vector<glm::vec2> plotPositions;
+	//The pool can not free sets, this one is counted in CreateDescriptorPool and left allocated
+	vk::DescriptorSetAllocateInfo setAllocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &descriptorSetLayout);
+	vk::DescriptorSet descriptorSet = m_vulkanResources->device.allocateDescriptorSets(setAllocInfo)[0];
 
-	for (int i = 0; i < plotPoints; i++)
+	vk::DescriptorImageInfo storageDescriptor = vk::DescriptorImageInfo({}, storageView, vk::ImageLayout::eGeneral);
+	std::vector<vk::WriteDescriptorSet> writeSets =
 	{
-		float radiusSquared = (xT * xT) + (zT * zT);
-		glm::vec3 forceDir = glm::normalize(glm::vec3(xT, yT, zT));
-		glm::vec3 gravAcc = glm::vec3(forceDir.x * G, forceDir.y * G, forceDir.z * G) / radiusSquared;
+		vk::WriteDescriptorSet(descriptorSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(equirect.descriptor), {}),
+		vk::WriteDescriptorSet(descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageImage, &storageDescriptor, {})
+	};
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
 
-		xV += (gravAcc.x * timestep);
-		zV += (gravAcc.z * timestep);
+	vk::ShaderModule skyShader = CompileShader("resources/shaders/sky.comp.spv");
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.stage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, skyShader, "main");
+	vk::Pipeline pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+	m_vulkanResources->device.destroyShaderModule(skyShader);
 
-		xT -= xV * timestep;
-		zT -= zV * timestep;
-		
-		plotPositions.emplace_back(glm::vec2(xT * SCALE,zT * SCALE));
-	}
+	//Compute writes the top level of every face, GenerateMipmaps blits the rest down from it
+	vk::CommandBuffer cmdBuffer = m_vulkanResources->commandPool.AllocateCommandBuffer();
+	cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	InsertImageMemoryBarrier(cmdBuffer, image, {}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+		vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 6));
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, {});
+	uint32_t groups = (faceSize + SKY_GROUP_SIZE - 1) / SKY_GROUP_SIZE;
+	cmdBuffer.dispatch(groups, groups, 6);
+	InsertImageMemoryBarrier(cmdBuffer, image, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal,
+		vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 6));
+	cmdBuffer.end();
 
-	return plotPositions;
+	vk::SubmitInfo submitInfo = vk::SubmitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+	m_vulkanResources->queueGraphics.submit({ submitInfo }, {});
+	m_vulkanResources->queueGraphics.waitIdle();
+	m_vulkanResources->commandPool.FreeCommandBuffers({ cmdBuffer });
+
+	GenerateMipmaps(m_textureStarfield, vk::Filter::eLinear, mipLevels, 6);
+	m_textureStarfield.SetImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	//Nothing from the conversion is kept, the mipmapped cubemap is about a fifth smaller than the mipmapped equirectangular image it replaces
+	m_vulkanResources->device.destroyPipeline(pipeline);
+	m_vulkanResources->device.destroyPipelineLayout(pipelineLayout);
+	m_vulkanResources->device.destroyDescriptorSetLayout(descriptorSetLayout);
+	m_vulkanResources->device.destroyImageView(storageView);
+	equirect.Destroy();
+
+	spdlog::info("Converted the starfield to a {0}x{0} cubemap with {1} levels", faceSize, mipLevels);
 }
 
-double OrreyVk::GetTimeQueryResult(uint32_t timeStampValidBits)
+void OrreyVk::PrepareSplats()
 {
-	std::array<std::uint64_t, 2> timeStamps = { {0} };
-	m_vulkanResources->device.getQueryPoolResults<std::uint64_t>(m_queryPool, 0, 2, timeStamps, sizeof(std::uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+	//Without 64 bit atomics sub-pixel objects are culled instead
+	m_splat.enabled = m_bufferInt64Atomics && m_viewCount == 1;
+	if (!m_splat.enabled)
+	{
+		if (m_viewCount > 1)
+			spdlog::info("Splatting sub-pixel objects draws a single view, they will be culled");
+		else
+			spdlog::info("Splatting sub-pixel objects needs 64 bit integers and buffer atomics, they will be culled");
+		return;
+	}
+
+	//Sized for the swapchain, a scaled down frame uses the start of it
+	vk::Extent2D dimensions = m_vulkanResources->swapchain.GetDimensions();
+	m_splat.buffer = CreateBuffer(dimensions.width * dimensions.height * sizeof(uint64_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	vk::DescriptorSetLayoutBinding layoutBinding = vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+	m_splat.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, 1, &layoutBinding));
+
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t));
+	m_splat.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_splat.descriptorSetLayout, 1, &pushConstantRange));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_splat.descriptorSetLayout);
+	m_splat.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	vk::WriteDescriptorSet writeSet = vk::WriteDescriptorSet(m_splat.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_splat.buffer.descriptor));
+	m_vulkanResources->device.updateDescriptorSets(1, &writeSet, 0, nullptr);
+
+	CreateSplatPipeline();
+}
+
+void OrreyVk::CreateSplatPipeline()
+{
+	//Composite pipeline - drawn inside the render pass so it is multisampled and resolved with the meshes
+	m_splat.pipeline = CreateFullScreenPipeline("resources/shaders/composite.frag.spv", m_splat.pipelineLayout, true);
+}
+
+vk::Pipeline OrreyVk::CreateFullScreenPipeline(const std::string& fragShaderPath, vk::PipelineLayout layout, bool depthTest)
+{
+	//A full screen triangle with no vertex input, for the main render pass
+	vk::ShaderModule vertShader = CompileShader("resources/shaders/composite.vert.spv");
+	vk::ShaderModule fragShader = CompileShader(fragShaderPath);
+	vk::PipelineShaderStageCreateInfo shaderStages[] = {
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main"),
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main")
+	};
+
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo();
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo({}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+
+	vk::Viewport viewport = vk::Viewport(0.0, 0.0, m_renderExtent.width, m_renderExtent.height, 0.0, 1.0);
+	vk::Rect2D scissor = vk::Rect2D({ 0,0 }, m_renderExtent);
+	vk::PipelineViewportStateCreateInfo viewPortState = vk::PipelineViewportStateCreateInfo({}, 1, &viewport, 1, &scissor);
+
+	vk::PipelineRasterizationStateCreateInfo rastierizer = vk::PipelineRasterizationStateCreateInfo();
+	rastierizer.cullMode = vk::CullModeFlagBits::eNone;
+
+	vk::PipelineMultisampleStateCreateInfo msState = vk::PipelineMultisampleStateCreateInfo();
+	msState.rasterizationSamples = m_msaaSamples;
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo = depthTest ? vk::PipelineDepthStencilStateCreateInfo({}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess) :
+		vk::PipelineDepthStencilStateCreateInfo({}, VK_FALSE, VK_FALSE, vk::CompareOp::eAlways);
+
+	vk::PipelineColorBlendAttachmentState colourBlendAttachState = vk::PipelineColorBlendAttachmentState();
+	colourBlendAttachState.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	vk::PipelineColorBlendStateCreateInfo colourBlendInfo = vk::PipelineColorBlendStateCreateInfo();
+	colourBlendInfo.pAttachments = &colourBlendAttachState;
+	colourBlendInfo.attachmentCount = 1;
+
+	vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo();
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewPortState;
+	pipelineInfo.pRasterizationState = &rastierizer;
+	pipelineInfo.pMultisampleState = &msState;
+	pipelineInfo.pDepthStencilState = &depthStencilInfo;
+	pipelineInfo.pColorBlendState = &colourBlendInfo;
+	pipelineInfo.layout = layout;
+	pipelineInfo.renderPass = m_vulkanResources->renderpass;
+	pipelineInfo.subpass = 0;
+
+	vk::Pipeline pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
+
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+	return pipeline;
+}
+
+void OrreyVk::PrepareOcclusion()
+{
+	//Sets are reserved for the levels a full resolution pyramid needs, a scaled down one uses the first of them
+	vk::Extent2D dimensions = m_vulkanResources->swapchain.GetDimensions();
+	uint32_t maxLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(dimensions.width, dimensions.height)))) + 1;
+	if (maxLevels > HIZ_MAX_LEVELS)
+	{
+		spdlog::error("The depth pyramid needs {} levels but only {} are reserved", maxLevels, HIZ_MAX_LEVELS);
+		maxLevels = HIZ_MAX_LEVELS;
+	}
+
+	//Depth formats are not always filterable, every read is a texelFetch anyway
+	vk::SamplerCreateInfo samplerCreateInfo = vk::SamplerCreateInfo();
+	samplerCreateInfo.magFilter = vk::Filter::eNearest;
+	samplerCreateInfo.minFilter = vk::Filter::eNearest;
+	samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
+	samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+	m_hiz.depthSampler = m_vulkanResources->device.createSampler(samplerCreateInfo);
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+	m_hiz.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+	m_hiz.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_hiz.descriptorSetLayout, 1, &pushConstantRange));
+
+	std::vector<vk::DescriptorSetLayout> layouts(maxLevels, m_hiz.descriptorSetLayout);
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, layouts.size(), layouts.data());
+	m_hiz.descriptorSets = m_vulkanResources->device.allocateDescriptorSets(allocInfo);
+
+	CreateOcclusionTargets();
+}
+
+void OrreyVk::CreateOcclusionTargets()
+{
+	//Render resolution at level 0, each level after halves down to a single texel
+	m_hiz.levels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_renderExtent.width, m_renderExtent.height)))) + 1;
+	m_hiz.levels = std::min<uint32_t>(m_hiz.levels, m_hiz.descriptorSets.size());
+
+	m_hiz.pyramid = CreateImage(vk::ImageType::e2D, vk::Format::eR32Sfloat, vk::Extent3D(m_renderExtent, 1), vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eColor,
+		{}, vk::SampleCountFlagBits::e1, vk::MemoryPropertyFlagBits::eDeviceLocal, m_hiz.levels);
+	m_hiz.pyramid.SetImageLayout(vk::ImageLayout::eGeneral);
+
+	//Kept in the general layout for good, the culling pass binds it before the first pyramid is built
+	vk::CommandBuffer cmdBuffer = m_vulkanResources->commandPool.AllocateCommandBuffer();
+	cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	InsertImageMemoryBarrier(cmdBuffer, m_hiz.pyramid.image, {}, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+		vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, m_hiz.levels, 0, 1));
+	cmdBuffer.end();
+
+	vk::SubmitInfo submitInfo = vk::SubmitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+	m_vulkanResources->queueGraphics.submit({ submitInfo }, {});
+	m_vulkanResources->queueGraphics.waitIdle();
+	m_vulkanResources->commandPool.FreeCommandBuffers({ cmdBuffer });
+
+	for (uint32_t level = 0; level < m_hiz.levels; level++)
+	{
+		vk::ImageViewCreateInfo viewCreateInfo = vk::ImageViewCreateInfo({}, m_hiz.pyramid.image, vk::ImageViewType::e2D, vk::Format::eR32Sfloat);
+		viewCreateInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1);
+		m_hiz.levelViews.push_back(m_vulkanResources->device.createImageView(viewCreateInfo));
+	}
+
+	//Level 0 reads the depth buffer, the rest read the level above. Level 0 binds itself as the source so the set is complete.
+	//The depth buffer and its sample count change with the anti-aliasing mode
+	vk::DescriptorImageInfo depthDescriptor = vk::DescriptorImageInfo(m_hiz.depthSampler, m_vulkanResources->swapchain.GetDepthImage().imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	std::vector<vk::DescriptorImageInfo> levelDescriptors;
+	for (uint32_t level = 0; level < m_hiz.levels; level++)
+		levelDescriptors.push_back(vk::DescriptorImageInfo({}, m_hiz.levelViews[level], vk::ImageLayout::eGeneral));
+
+	std::vector<vk::WriteDescriptorSet> writeSets;
+	for (uint32_t level = 0; level < m_hiz.levels; level++)
+	{
+		writeSets.push_back(vk::WriteDescriptorSet(m_hiz.descriptorSets[level], 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &depthDescriptor, {}));
+		writeSets.push_back(vk::WriteDescriptorSet(m_hiz.descriptorSets[level], 1, 0, 1, vk::DescriptorType::eStorageImage, &levelDescriptors[level > 0 ? level - 1 : 0], {}));
+		writeSets.push_back(vk::WriteDescriptorSet(m_hiz.descriptorSets[level], 2, 0, 1, vk::DescriptorType::eStorageImage, &levelDescriptors[level], {}));
+	}
+	//The culling pass samples the whole pyramid, PrepareCulling binds the first one
+	if (m_cull.descriptorSet)
+		writeSets.push_back(vk::WriteDescriptorSet(m_cull.descriptorSet, 8, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_hiz.pyramid.descriptor), {}));
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	vk::ShaderModule hizShader = CompileShader(m_msaaSamples != vk::SampleCountFlagBits::e1 ? "resources/shaders/hiz_ms.comp.spv" : "resources/shaders/hiz.comp.spv");
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+	pipelineCreateInfo.layout = m_hiz.pipelineLayout;
+	pipelineCreateInfo.stage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, hizShader, "main");
+	m_hiz.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	m_vulkanResources->device.destroyShaderModule(hizShader);
+}
+
+void OrreyVk::PrepareVisibility()
+{
+	if (!VISIBILITY_BUFFER)
+		return;
+
+	//gl_PrimitiveID is only readable in fragment shaders with the geometry shader feature. Everything else is already single sampled
+	if (!m_vulkanResources->physicalDevice.getFeatures().geometryShader)
+	{
+		spdlog::warn("Visibility buffer needs the geometry shader feature, shading forward single sampled instead");
+		return;
+	}
+	if (m_viewCount > 1)
+	{
+		spdlog::warn("Visibility buffer draws a single view, shading forward single sampled instead");
+		return;
+	}
+	m_visibility.enabled = true;
+
+	vk::Extent2D dimensions = m_vulkanResources->swapchain.GetDimensions();
+	m_visibility.image = CreateImage(vk::ImageType::e2D, vk::Format::eR32G32Uint, vk::Extent3D(dimensions, 1), vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eColor,
+		{}, vk::SampleCountFlagBits::e1, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	//Ids and the shared depth buffer, the first phase clears both and the second loads them. The ids are read by the shading pass after it
+	vk::AttachmentDescription idAttachDesc = vk::AttachmentDescription({}, vk::Format::eR32G32Uint);
+	idAttachDesc.loadOp = vk::AttachmentLoadOp::eClear;
+	idAttachDesc.storeOp = vk::AttachmentStoreOp::eStore;
+	idAttachDesc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+	idAttachDesc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+	idAttachDesc.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+	vk::AttachmentDescription depthAttachDesc = vk::AttachmentDescription({}, vk::Format::eD32Sfloat);
+	depthAttachDesc.loadOp = vk::AttachmentLoadOp::eClear;
+	depthAttachDesc.storeOp = vk::AttachmentStoreOp::eStore;
+	depthAttachDesc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+	depthAttachDesc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+	depthAttachDesc.samples = m_msaaSamples;
+	depthAttachDesc.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+	vk::AttachmentReference idAttachRef = vk::AttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+	vk::AttachmentReference depthAttachRef = vk::AttachmentReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+	vk::SubpassDescription subpass = vk::SubpassDescription();
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &idAttachRef;
+	subpass.pDepthStencilAttachment = &depthAttachRef;
+
+	//Last frame's shading pass has to finish reading the ids, and its colour pass testing against the depth, before either is cleared
+	vk::SubpassDependency dependency = vk::SubpassDependency();
+	dependency.srcStageMask = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eLateFragmentTests;
+	dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+	dependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+	dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+	std::vector<vk::AttachmentDescription> attachments = { idAttachDesc, depthAttachDesc };
+	vk::RenderPassCreateInfo renderPassCreateInfo = vk::RenderPassCreateInfo({}, attachments.size(), attachments.data(), 1, &subpass, 1, &dependency);
+	m_visibility.renderpass = m_vulkanResources->device.createRenderPass(renderPassCreateInfo);
+
+	attachments[0].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[0].initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+	attachments[1].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[1].initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+	m_visibility.renderpassLoad = m_vulkanResources->device.createRenderPass(renderPassCreateInfo);
+
+	//Id pipelines read the same set as the planets, the bucket of each draw is pushed before it
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t));
+	m_visibility.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_graphics.descriptorSetLayout, 1, &pushConstantRange));
+
+	vk::ShaderModule vertShader = CompileShader("resources/shaders/planets_vis.vert.spv");
+	vk::ShaderModule fragShader = CompileShader("resources/shaders/visibility.frag.spv");
+	vk::PipelineShaderStageCreateInfo shaderStages[] = {
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main"),
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main")
+	};
+
+	std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions = m_sphere.GetVertexAttributeDescription();
+	std::vector<vk::VertexInputBindingDescription> bindingDesc = { m_sphere.GetVertexBindingDescription() };
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo({}, 1, bindingDesc.data(), vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo({}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+
+	vk::Viewport viewport = vk::Viewport(0.0, 0.0, dimensions.width, dimensions.height, 0.0, 1.0);
+	vk::Rect2D scissor = vk::Rect2D({ 0,0 }, dimensions);
+	vk::PipelineViewportStateCreateInfo viewPortState = vk::PipelineViewportStateCreateInfo({}, 1, &viewport, 1, &scissor);
+
+	vk::PipelineRasterizationStateCreateInfo rastierizer = vk::PipelineRasterizationStateCreateInfo();
+	rastierizer.cullMode = vk::CullModeFlagBits::eBack;
+	rastierizer.frontFace = vk::FrontFace::eClockwise;
+
+	vk::PipelineMultisampleStateCreateInfo msState = vk::PipelineMultisampleStateCreateInfo();
+	msState.rasterizationSamples = m_msaaSamples;
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo = vk::PipelineDepthStencilStateCreateInfo({}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess);
+
+	//Integer attachments are never blended
+	vk::PipelineColorBlendAttachmentState colourBlendAttachState = vk::PipelineColorBlendAttachmentState();
+	colourBlendAttachState.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG;
+	vk::PipelineColorBlendStateCreateInfo colourBlendInfo = vk::PipelineColorBlendStateCreateInfo();
+	colourBlendInfo.pAttachments = &colourBlendAttachState;
+	colourBlendInfo.attachmentCount = 1;
+
+	vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo();
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewPortState;
+	pipelineInfo.pRasterizationState = &rastierizer;
+	pipelineInfo.pMultisampleState = &msState;
+	pipelineInfo.pDepthStencilState = &depthStencilInfo;
+	pipelineInfo.pColorBlendState = &colourBlendInfo;
+	pipelineInfo.layout = m_visibility.pipelineLayout;
+	pipelineInfo.renderPass = m_visibility.renderpass;
+	pipelineInfo.subpass = 0;
+
+	m_visibility.pipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
+
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+
+	//Impostors are still ray cast for their silhouette and depth, then write the impostor bucket instead of a triangle
+	vertShader = CompileShader("resources/shaders/impostor_vis.vert.spv");
+	fragShader = CompileShader("resources/shaders/impostor_vis.frag.spv");
+	shaderStages[0] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main");
+	shaderStages[1] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main");
+	rastierizer.cullMode = vk::CullModeFlagBits::eNone;
+
+	m_visibility.pipelineImpostors = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
+
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+
+	//Shading pass - the triangle under each pixel is fetched from the sphere buffers and transformed again, so it needs everything planets.vert reads
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment)
+	};
+	m_visibility.shadeDescriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+
+	//Viewport size, then the first index and vertex offset of every level of detail
+	pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, (2 + 2 * SPHERE_LOD_COUNT) * sizeof(uint32_t));
+	m_visibility.shadePipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_visibility.shadeDescriptorSetLayout, 1, &pushConstantRange));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_visibility.shadeDescriptorSetLayout);
+	m_visibility.shadeDescriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	vk::DescriptorImageInfo idDescriptor = vk::DescriptorImageInfo(m_hiz.depthSampler, m_visibility.image.imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.renderBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &idDescriptor, {}),
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 2, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureArrayPlanets.descriptor), {}),
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 4, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferVertex.descriptor)),
+		vk::WriteDescriptorSet(m_visibility.shadeDescriptorSet, 5, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferIndex.descriptor))
+	};
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	CreateVisibilityTargets();
+
+	spdlog::info("Visibility buffer enabled, objects are shaded once per pixel");
+}
+
+void OrreyVk::CreateVisibilityTargets()
+{
+	//The id image is swapchain sized, a scaled down frame only draws into the corner of it
+	std::vector<vk::ImageView> framebufferAttachments = { m_visibility.image.imageView, m_vulkanResources->swapchain.GetDepthImage().imageView };
+	vk::FramebufferCreateInfo framebufferCreateInfo = vk::FramebufferCreateInfo({}, m_visibility.renderpass, framebufferAttachments.size(), framebufferAttachments.data(), m_renderExtent.width, m_renderExtent.height, 1);
+	m_visibility.framebuffer = m_vulkanResources->device.createFramebuffer(framebufferCreateInfo);
+
+	//Drawn first in the colour pass, the sky fills in behind it. Depth was written with the ids, so nothing is tested here
+	m_visibility.shadePipeline = CreateFullScreenPipeline("resources/shaders/visibility_shade.frag.spv", m_visibility.shadePipelineLayout, false);
+}
+
+void OrreyVk::PrepareAntiAliasing()
+{
+	//Post passes blit their result into the swapchain image, converting it to the swapchain's format on the way
+	vk::FormatProperties swapchainFormatProperties = m_vulkanResources->physicalDevice.getFormatProperties(m_vulkanResources->swapchain.GetSwapchainFormat());
+	m_aa.postSupported = (m_vulkanResources->swapchain.GetImageUsage() & vk::ImageUsageFlagBits::eTransferDst) && (swapchainFormatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitDst);
+	if (!m_aa.postSupported)
+		spdlog::warn("Swapchain images cannot be blitted to, FXAA, temporal anti-aliasing and dynamic resolution are unavailable");
+
+	//The post pass output is written as storage, blitted from and, as the temporal history, sampled with linear filtering.
+	//Its format can't be copied into the swapchain's, so without blits the anti-aliasing passes are left off
+	vk::FormatProperties outputFormatProperties = m_vulkanResources->physicalDevice.getFormatProperties(vk::Format::eR16G16B16A16Sfloat);
+	vk::FormatFeatureFlags outputFeatures = outputFormatProperties.optimalTilingFeatures;
+	m_aa.outputBlit = (outputFeatures & vk::FormatFeatureFlagBits::eStorageImage) && (outputFeatures & vk::FormatFeatureFlagBits::eBlitSrc);
+	m_aa.outputFilter = (outputFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear) ? vk::Filter::eLinear : vk::Filter::eNearest;
+	if (!m_aa.outputBlit)
+		spdlog::warn("R16G16B16A16 images cannot be stored to and blitted from, FXAA and temporal anti-aliasing are unavailable");
+	else if (m_aa.outputFilter != vk::Filter::eLinear)
+		spdlog::warn("R16G16B16A16 images cannot be filtered, temporal anti-aliasing is unavailable and FXAA is scaled up unfiltered");
+
+	m_aa.uniformBuffer = CreateBuffer(sizeof(AntiAliasingUniforms), vk::BufferUsageFlagBits::eUniformBuffer);
+	m_aa.uniformBuffer.Map();
+
+	//Filtered reads of the scene and the history land between texels
+	vk::SamplerCreateInfo samplerCreateInfo = vk::SamplerCreateInfo();
+	samplerCreateInfo.magFilter = vk::Filter::eLinear;
+	samplerCreateInfo.minFilter = vk::Filter::eLinear;
+	samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
+	samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+	m_aa.sampler = m_vulkanResources->device.createSampler(samplerCreateInfo);
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+	m_aa.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+	m_aa.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_aa.descriptorSetLayout));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_aa.descriptorSetLayout);
+	m_aa.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	vk::ShaderModule fxaaShader = CompileShader("resources/shaders/fxaa.comp.spv");
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+	pipelineCreateInfo.layout = m_aa.pipelineLayout;
+	pipelineCreateInfo.stage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, fxaaShader, "main");
+	m_aa.fxaaPipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+	m_vulkanResources->device.destroyShaderModule(fxaaShader);
+
+	vk::ShaderModule taaShader = CompileShader("resources/shaders/taa.comp.spv");
+	pipelineCreateInfo.stage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, taaShader, "main");
+	m_aa.taaPipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+	m_vulkanResources->device.destroyShaderModule(taaShader);
+}
+
+void OrreyVk::CreateAntiAliasingTargets()
+{
+	vk::Extent3D extent = vk::Extent3D(m_renderExtent, 1);
+	bool temporal = m_aa.mode == AntiAliasing::eTaa;
+	m_aa.outputImage = CreateImage(vk::ImageType::e2D, vk::Format::eR16G16B16A16Sfloat, extent, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc, vk::ImageAspectFlagBits::eColor,
+		{}, vk::SampleCountFlagBits::e1, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	if (temporal)
+		m_aa.historyImage = CreateImage(vk::ImageType::e2D, vk::Format::eR16G16B16A16Sfloat, extent, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vk::ImageAspectFlagBits::eColor,
+			{}, vk::SampleCountFlagBits::e1, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	//The output is kept in the general layout for good, the history is only out of the read only layout while it is copied to
+	vk::ImageSubresourceRange colourRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	vk::CommandBuffer cmdBuffer = m_vulkanResources->commandPool.AllocateCommandBuffer();
+	cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	InsertImageMemoryBarrier(cmdBuffer, m_aa.outputImage.image, {}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+		vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, colourRange);
+	if (temporal)
+		InsertImageMemoryBarrier(cmdBuffer, m_aa.historyImage.image, {}, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, colourRange);
+	cmdBuffer.end();
+
+	vk::SubmitInfo submitInfo = vk::SubmitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+	m_vulkanResources->queueGraphics.submit({ submitInfo }, {});
+	m_vulkanResources->queueGraphics.waitIdle();
+	m_vulkanResources->commandPool.FreeCommandBuffers({ cmdBuffer });
+
+	//FXAA only reads the scene, the history and depth are bound for temporal AA
+	vk::DescriptorImageInfo sceneDescriptor = vk::DescriptorImageInfo(m_aa.sampler, m_vulkanResources->swapchain.GetColourImage().imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::DescriptorImageInfo depthDescriptor = vk::DescriptorImageInfo(m_hiz.depthSampler, m_vulkanResources->swapchain.GetDepthImage().imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::DescriptorImageInfo historyDescriptor = vk::DescriptorImageInfo(m_aa.sampler, m_aa.historyImage.imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::DescriptorImageInfo outputDescriptor = vk::DescriptorImageInfo({}, m_aa.outputImage.imageView, vk::ImageLayout::eGeneral);
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_aa.descriptorSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &sceneDescriptor, {}),
+		vk::WriteDescriptorSet(m_aa.descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageImage, &outputDescriptor, {})
+	};
+	if (temporal)
+	{
+		writeSets.push_back(vk::WriteDescriptorSet(m_aa.descriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &depthDescriptor, {}));
+		writeSets.push_back(vk::WriteDescriptorSet(m_aa.descriptorSet, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &historyDescriptor, {}));
+		writeSets.push_back(vk::WriteDescriptorSet(m_aa.descriptorSet, 4, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_aa.uniformBuffer.descriptor)));
+	}
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+}
+
+void OrreyVk::DestroyRenderTargetResources()
+{
+	//Everything that holds a render pass, a sample count, the render size or a view of the render targets
+	m_vulkanResources->device.destroyPipeline(m_graphics.pipelinePlanets.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_graphics.pipelineOrbits.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_graphics.pipelineSky.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_graphics.pipelineImpostors.pipeline);
+	if (m_splat.enabled)
+		m_vulkanResources->device.destroyPipeline(m_splat.pipeline);
+	if (!m_aggregate.populations.empty())
+		m_vulkanResources->device.destroyPipeline(m_aggregate.drawPipeline);
+	m_vulkanResources->device.destroyPipeline(m_hiz.pipeline);
+	for (vk::ImageView view : m_hiz.levelViews)
+		m_vulkanResources->device.destroyImageView(view);
+	m_hiz.levelViews.clear();
+	m_hiz.pyramid.Destroy();
+	if (m_visibility.enabled)
+	{
+		m_vulkanResources->device.destroyFramebuffer(m_visibility.framebuffer);
+		m_vulkanResources->device.destroyPipeline(m_visibility.shadePipeline);
+	}
+	if (m_aa.outputImage.image)
+	{
+		m_aa.outputImage.Destroy();
+		m_aa.outputImage = vko::Image();
+	}
+	if (m_aa.historyImage.image)
+	{
+		m_aa.historyImage.Destroy();
+		m_aa.historyImage = vko::Image();
+	}
+}
+
+bool OrreyVk::IsAntiAliasingSupported(AntiAliasing mode)
+{
+	switch (mode)
+	{
+	case AntiAliasing::eMsaa:
+		//Render stream ids cannot be resolved, the visibility buffer stays single sampled
+		return m_maxMsaaSamples != vk::SampleCountFlagBits::e1 && !m_visibility.enabled;
+	case AntiAliasing::eFxaa:
+		//Both read and write a single layer
+		return m_aa.postSupported && m_aa.outputBlit && m_viewCount == 1;
+	case AntiAliasing::eTaa:
+		//The history is sampled between texels
+		return m_aa.postSupported && m_aa.outputBlit && m_aa.outputFilter == vk::Filter::eLinear && m_viewCount == 1;
+	default:
+		return true;
+	}
+}
+
+std::string OrreyVk::GetAntiAliasingName(AntiAliasing mode)
+{
+	switch (mode)
+	{
+	case AntiAliasing::eMsaa:
+		return "MSAA x" + std::to_string(static_cast<uint32_t>(m_maxMsaaSamples));
+	case AntiAliasing::eFxaa:
+		return "FXAA";
+	case AntiAliasing::eTaa:
+		return "temporal";
+	default:
+		return "off";
+	}
+}
+
+void OrreyVk::CycleAntiAliasing()
+{
+	//On to the next mode this device and configuration can run
+	for (uint32_t i = 1; i < 4; i++)
+	{
+		AntiAliasing mode = static_cast<AntiAliasing>((static_cast<uint32_t>(m_aa.mode) + i) % 4);
+		if (IsAntiAliasingSupported(mode))
+		{
+			SetAntiAliasing(mode);
+			return;
+		}
+	}
+}
+
+void OrreyVk::SetAntiAliasing(AntiAliasing mode)
+{
+	if (!IsAntiAliasingSupported(mode))
+	{
+		spdlog::warn("Anti-aliasing {} is not supported here, staying with {}", GetAntiAliasingName(mode), GetAntiAliasingName(m_aa.mode));
+		return;
+	}
+
+	ReportAntiAliasingCost();
+	m_aa.mode = mode;
+	RebuildRenderTargets();
+
+	spdlog::info("Anti-aliasing: {}", GetAntiAliasingName(m_aa.mode));
+}
+
+void OrreyVk::RebuildRenderTargets()
+{
+	//Sample counts, sizes and attachments are baked into the render passes and the pipelines, so both are built again. The next frame is recorded against them
+	m_vulkanResources->device.waitIdle();
+	DestroyRenderTargetResources();
+	DestroyRenderTargets();
+
+	//A scaled down frame goes through the offscreen target too, the blit into the swapchain image scales it up
+	bool antiAliasingPass = m_aa.mode == AntiAliasing::eFxaa || m_aa.mode == AntiAliasing::eTaa;
+	m_msaaSamples = m_aa.mode == AntiAliasing::eMsaa ? m_maxMsaaSamples : vk::SampleCountFlagBits::e1;
+	m_postProcess = antiAliasingPass || m_renderExtent != m_vulkanResources->swapchain.GetDimensions();
+	CreateRenderTargets();
+
+	CreateGraphicsPipeline();
+	if (m_splat.enabled)
+		CreateSplatPipeline();
+	if (!m_aggregate.populations.empty())
+		CreateAggregatePipeline();
+	CreateOcclusionTargets();
+	if (m_visibility.enabled)
+		CreateVisibilityTargets();
+	if (antiAliasingPass)
+		CreateAntiAliasingTargets();
+
+	//Drops any jitter, and starts the temporal history over from the next frame
+	UpdateCameraUniformBuffer();
+	m_aa.previousViewProjection = m_graphics.ubo.viewProjection;
+	m_aa.uniforms.reprojection = glm::mat4(1.0f);
+	m_aa.uniforms.jitter = glm::vec2(0.0f);
+	m_aa.uniforms.blend = TAA_BLEND;
+	m_aa.uniforms.historyValid = 0;
+	memcpy(m_aa.uniformBuffer.mapped, &m_aa.uniforms, sizeof(AntiAliasingUniforms));
+}
+
+void OrreyVk::UpdateAntiAliasing()
+{
+	if (m_aa.mode != AntiAliasing::eTaa)
+		return;
+
+	//Halton(2, 3) offset within the pixel, centred on it
+	auto halton = [](uint32_t index, uint32_t base) {
+		float result = 0.0f;
+		for (float fraction = 1.0f / base; index > 0; index /= base, fraction /= base)
+			result += fraction * (index % base);
+		return result;
+	};
+	uint32_t phase = m_aa.frame++ % TAA_JITTER_PHASES + 1;
+	glm::vec2 jitter = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+
+	//The frame just drawn is the history for the next one, which reprojects through the camera motion between them
+	glm::mat4 viewProjection = m_graphics.ubo.projection * m_graphics.ubo.view * m_graphics.ubo.model;
+	m_aa.uniforms.reprojection = m_aa.previousViewProjection * glm::inverse(viewProjection);
+	m_aa.uniforms.jitter = jitter;
+	m_aa.uniforms.historyValid = 1;
+	memcpy(m_aa.uniformBuffer.mapped, &m_aa.uniforms, sizeof(AntiAliasingUniforms));
+	m_aa.previousViewProjection = viewProjection;
+
+	//Shift everything drawn through viewProjection by the jitter in clip space, the sky is smooth enough to be left alone
+	glm::vec2 offset = jitter * 2.0f / glm::vec2(m_renderExtent.width, m_renderExtent.height);
+	m_graphics.ubo.viewProjection = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * viewProjection;
+	m_graphics.ubo.views[0].viewProjection = m_graphics.ubo.viewProjection;
+	memcpy(m_graphics.uniformBuffer.mapped, &m_graphics.ubo, sizeof(m_graphics.ubo));
+}
+
+void OrreyVk::PostProcess(vk::CommandBuffer cmdBuffer, vk::Image swapchainImage)
+{
+	vk::Extent2D dimensions = m_renderExtent;
+	vk::Extent2D swapchainDimensions = m_vulkanResources->swapchain.GetDimensions();
+	vk::ImageSubresourceRange colourRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	vk::ImageSubresourceLayers colourLayers = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	vk::ImageSubresourceRange viewsRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, m_viewCount);
+	bool temporal = m_aa.mode == AntiAliasing::eTaa;
+
+	//Without a post anti-aliasing pass the scene is only here to be scaled up, it is blitted as it is
+	vk::Image source = m_vulkanResources->swapchain.GetColourImage().image;
+	vk::ImageLayout sourceLayout = vk::ImageLayout::eTransferSrcOptimal;
+	if (m_aa.mode == AntiAliasing::eFxaa || temporal)
+	{
+		InsertImageMemoryBarrier(cmdBuffer, m_vulkanResources->swapchain.GetColourImage().image,
+			vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eComputeShader,
+			colourRange);
+		//Left read only, the next frame's first pass clears it
+		if (temporal)
+			InsertImageMemoryBarrier(cmdBuffer, m_vulkanResources->swapchain.GetDepthImage().image,
+				vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eShaderRead,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
+		//Last frame's blit and history copy have to finish reading the output before it is written again
+		InsertImageMemoryBarrier(cmdBuffer, m_aa.outputImage.image,
+			vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderWrite,
+			vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+			colourRange);
+
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, temporal ? m_aa.taaPipeline : m_aa.fxaaPipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_aa.pipelineLayout, 0, m_aa.descriptorSet, {});
+		cmdBuffer.dispatch((dimensions.width + 7) / 8, (dimensions.height + 7) / 8, 1);
+
+		InsertImageMemoryBarrier(cmdBuffer, m_aa.outputImage.image,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead,
+			vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+			colourRange);
+
+		if (temporal)
+		{
+			//Kept for the next frame to reproject
+			InsertImageMemoryBarrier(cmdBuffer, m_aa.historyImage.image,
+				vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite,
+				vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferDstOptimal,
+				vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+				colourRange);
+			vk::ImageCopy copyRegion = vk::ImageCopy(colourLayers, { 0, 0, 0 }, colourLayers, { 0, 0, 0 }, vk::Extent3D(dimensions, 1));
+			cmdBuffer.copyImage(m_aa.outputImage.image, vk::ImageLayout::eGeneral, m_aa.historyImage.image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+			InsertImageMemoryBarrier(cmdBuffer, m_aa.historyImage.image,
+				vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+				vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+				colourRange);
+		}
+
+		source = m_aa.outputImage.image;
+		sourceLayout = vk::ImageLayout::eGeneral;
+	}
+	else
+	{
+		InsertImageMemoryBarrier(cmdBuffer, source,
+			vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eTransferRead,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+			viewsRange);
+	}
+
+	//The swapchain image comes straight from the presentation engine, the acquire is waited on at colour output.
+	//Scaled down frames are filtered up to it
+	InsertImageMemoryBarrier(cmdBuffer, swapchainImage,
+		{}, vk::AccessFlagBits::eTransferWrite,
+		vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+		vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+		colourRange);
+	//Each view's layer fills its share of the width, left to right
+	std::vector<vk::ImageBlit> blitRegions;
+	for (uint32_t view = 0; view < m_viewCount; view++)
+	{
+		std::array<vk::Offset3D, 2> sourceCorners = { vk::Offset3D(0, 0, 0), vk::Offset3D(dimensions.width, dimensions.height, 1) };
+		std::array<vk::Offset3D, 2> swapchainCorners = { vk::Offset3D(swapchainDimensions.width * view / m_viewCount, 0, 0), vk::Offset3D(swapchainDimensions.width * (view + 1) / m_viewCount, swapchainDimensions.height, 1) };
+		blitRegions.push_back(vk::ImageBlit(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, view, 1), sourceCorners, colourLayers, swapchainCorners));
+	}
+	bool unscaled = dimensions.width * m_viewCount == swapchainDimensions.width && dimensions.height == swapchainDimensions.height;
+	vk::Filter filter = source == m_aa.outputImage.image ? m_aa.outputFilter : vk::Filter::eLinear;
+	cmdBuffer.blitImage(source, sourceLayout, swapchainImage, vk::ImageLayout::eTransferDstOptimal, blitRegions.size(), blitRegions.data(), unscaled ? vk::Filter::eNearest : filter);
+	InsertImageMemoryBarrier(cmdBuffer, swapchainImage,
+		vk::AccessFlagBits::eTransferWrite, {},
+		vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::ePresentSrcKHR,
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+		colourRange);
+}
+
+void OrreyVk::ReportAntiAliasingCost()
+{
+	if (m_aa.timedFrames == 0)
+		return;
+
+	spdlog::info("Anti-aliasing {}: {:.3f}ms both render passes, {:.3f}ms post pass, over {} frames",
+		GetAntiAliasingName(m_aa.mode), m_aa.sceneTime / m_aa.timedFrames, m_aa.postTime / m_aa.timedFrames, m_aa.timedFrames);
+	m_aa.sceneTime = 0.0;
+	m_aa.postTime = 0.0;
+	m_aa.timedFrames = 0;
+}
+
+void OrreyVk::PrepareGovernor()
+{
+	if (m_governor.budget < 0.0f)
+		m_governor.budget = FRAME_BUDGET_MS;
+
+	//Scaling the resolution down goes through the same blit as the post passes
+	uint32_t scaleLevels = static_cast<uint32_t>((1.0f - GOVERNOR_MIN_SCALE) / GOVERNOR_SCALE_STEP + 0.5f);
+	m_governor.knobs[static_cast<size_t>(GovernorKnob::eRenderScale)].maxLevel = m_aa.postSupported ? scaleLevels : 0;
+	m_governor.knobs[static_cast<size_t>(GovernorKnob::eLodBias)].maxLevel = GOVERNOR_MAX_BIAS;
+	m_governor.knobs[static_cast<size_t>(GovernorKnob::eImpostorCutoff)].maxLevel = IMPOSTOR_PIXEL_SIZE > 0.0f ? GOVERNOR_MAX_BIAS : 0;
+	m_governor.knobs[static_cast<size_t>(GovernorKnob::eAmplification)].maxLevel = AMPLIFY_COPIES - 1;
+	m_governor.knobs[static_cast<size_t>(GovernorKnob::eSubsteps)].maxLevel = SIMULATION_SUBSTEPS - 1;
+	//Without a budget there is nothing to spend substeps on, frames take one step unless one is pinned
+	if (m_governor.budget <= 0.0f)
+		m_governor.knobs[static_cast<size_t>(GovernorKnob::eSubsteps)].level = SIMULATION_SUBSTEPS - 1;
+
+	//Pins are given as values, the level nearest each is held
+	for (size_t i = 0; i < static_cast<size_t>(GovernorKnob::eCount); i++)
+	{
+		GovernorKnobState& knob = m_governor.knobs[i];
+		if (knob.pin < 0.0f)
+			continue;
+
+		float level = knob.pin;
+		if (static_cast<GovernorKnob>(i) == GovernorKnob::eRenderScale)
+			level = (1.0f - knob.pin) / GOVERNOR_SCALE_STEP;
+		else if (static_cast<GovernorKnob>(i) == GovernorKnob::eAmplification)
+			level = AMPLIFY_COPIES - knob.pin;
+		else if (static_cast<GovernorKnob>(i) == GovernorKnob::eSubsteps)
+			level = SIMULATION_SUBSTEPS - knob.pin;
+		knob.level = std::min(static_cast<uint32_t>(std::max(level + 0.5f, 0.0f)), knob.maxLevel);
+	}
+	UpdateGovernorValues();
+
+	if (m_governor.budget > 0.0f)
+		spdlog::info("Governor: Holding frames to {:.1f}ms", m_governor.budget);
+	else
+		spdlog::info("Governor: Off, every knob stays where it starts and frames take {} step(s)", m_governor.substeps);
+}
+
+void OrreyVk::PinGovernorKnob(const std::string& name, float value)
+{
+	for (size_t i = 0; i < static_cast<size_t>(GovernorKnob::eCount); i++)
+	{
+		if (GetGovernorKnobName(static_cast<GovernorKnob>(i)) == name)
+		{
+			m_governor.knobs[i].pin = std::max(value, 0.0f);
+			return;
+		}
+	}
+	spdlog::warn("Governor: No knob called {}, the knobs are scale, lod, impostor, amplify and substeps", name);
+}
+
+std::string OrreyVk::GetGovernorKnobName(GovernorKnob knob)
+{
+	switch (knob)
+	{
+	case GovernorKnob::eRenderScale:
+		return "scale";
+	case GovernorKnob::eLodBias:
+		return "lod";
+	case GovernorKnob::eImpostorCutoff:
+		return "impostor";
+	case GovernorKnob::eAmplification:
+		return "amplify";
+	default:
+		return "substeps";
+	}
+}
+
+void OrreyVk::UpdateGovernorValues()
+{
+	m_governor.lodPixelSize = SPHERE_LOD_PIXEL_SIZE * (1u << m_governor.knobs[static_cast<size_t>(GovernorKnob::eLodBias)].level);
+	m_governor.impostorPixelSize = IMPOSTOR_PIXEL_SIZE * (1u << m_governor.knobs[static_cast<size_t>(GovernorKnob::eImpostorCutoff)].level);
+	m_governor.copies = AMPLIFY_COPIES - m_governor.knobs[static_cast<size_t>(GovernorKnob::eAmplification)].level;
+	m_governor.substeps = SIMULATION_SUBSTEPS - m_governor.knobs[static_cast<size_t>(GovernorKnob::eSubsteps)].level;
+}
+
+void OrreyVk::SetGovernorLevel(GovernorKnob knob, uint32_t level)
+{
+	GovernorKnobState& state = m_governor.knobs[static_cast<size_t>(knob)];
+	state.level = std::min(level, state.maxLevel);
+	UpdateGovernorValues();
+
+	switch (knob)
+	{
+	case GovernorKnob::eRenderScale:
+	{
+		vk::Extent2D dimensions = m_vulkanResources->swapchain.GetDimensions();
+		dimensions.width /= m_viewCount;
+		float scale = 1.0f - state.level * GOVERNOR_SCALE_STEP;
+		m_renderExtent = vk::Extent2D(std::max(static_cast<uint32_t>(dimensions.width * scale + 0.5f), 1u), std::max(static_cast<uint32_t>(dimensions.height * scale + 0.5f), 1u));
+		RebuildRenderTargets();
+		break;
+	}
+	case GovernorKnob::eLodBias:
+	case GovernorKnob::eImpostorCutoff:
+	case GovernorKnob::eAmplification:
+		//Pushed to cull.comp, or how many times it is dispatched, when the next frame is recorded
+		break;
+	default:
+		m_compute.rerecord = true;
+		break;
+	}
+}
+
+void OrreyVk::UpdateGovernor(double gpuTime)
+{
+	if (m_governor.budget <= 0.0f)
+		return;
+
+	m_governor.frameTime += m_frameTime * 1000.0;
+	m_governor.gpuTime += gpuTime;
+	if (++m_governor.frames < GOVERNOR_WINDOW)
+		return;
+
+	double frameTime = m_governor.frameTime / m_governor.frames;
+	gpuTime = m_governor.gpuTime / m_governor.frames;
+	m_governor.frameTime = 0.0;
+	m_governor.gpuTime = 0.0;
+	m_governor.frames = 0;
+	if (m_governor.settling)
+	{
+		m_governor.settling = false;
+		return;
+	}
+
+	//Down as soon as a window runs over, back up only after several with the GPU well clear of the budget. Between the two nothing moves,
+	//which also keeps a vsynced frame that exactly meets the budget where it is
+	bool over = frameTime > m_governor.budget * GOVERNOR_OVER_BUDGET;
+	bool quiet = !over && gpuTime < m_governor.budget * GOVERNOR_UNDER_BUDGET;
+	m_governor.quietWindows = quiet ? m_governor.quietWindows + 1 : 0;
+	if (!over && m_governor.quietWindows < GOVERNOR_RAISE_WINDOWS)
+		return;
+
+	//Render bound frames give up the amplified copies, then detail before resolution and keep the simulation for last, the other way round when the
+	//time goes elsewhere. Raising undoes the most visible first
+	std::vector<GovernorKnob> order = { GovernorKnob::eRenderScale, GovernorKnob::eImpostorCutoff, GovernorKnob::eLodBias, GovernorKnob::eAmplification, GovernorKnob::eSubsteps };
+	if (over && gpuTime >= frameTime * 0.5)
+		order = { GovernorKnob::eAmplification, GovernorKnob::eLodBias, GovernorKnob::eImpostorCutoff, GovernorKnob::eRenderScale, GovernorKnob::eSubsteps };
+	else if (over)
+		order = { GovernorKnob::eSubsteps, GovernorKnob::eAmplification, GovernorKnob::eLodBias, GovernorKnob::eImpostorCutoff, GovernorKnob::eRenderScale };
+
+	for (GovernorKnob knob : order)
+	{
+		const GovernorKnobState& state = m_governor.knobs[static_cast<size_t>(knob)];
+		if (state.pin >= 0.0f || (over ? state.level == state.maxLevel : state.level == 0))
+			continue;
+
+		spdlog::info("Governor: {:.2f}ms a frame, {:.2f}ms on the GPU, against {:.1f}ms. {} {}",
+			frameTime, gpuTime, m_governor.budget, over ? "Lowering" : "Raising", GetGovernorKnobName(knob));
+		SetGovernorLevel(knob, over ? state.level + 1 : state.level - 1);
+		m_governor.quietWindows = 0;
+		m_governor.settling = true;
+		ReportGovernor();
+		return;
+	}
+}
+
+void OrreyVk::ReportGovernor()
+{
+	spdlog::info("Governor: Rendering {}x{}, levels of detail from {}px, impostors under {}px, {} copies of each test particle, {} substeps a frame",
+		m_renderExtent.width, m_renderExtent.height, m_governor.lodPixelSize, m_governor.impostorPixelSize, m_governor.copies, m_governor.substeps);
+}
+
+void OrreyVk::PrepareCulling()
+{
+	//One box per planets.comp workgroup across every system, written each step. PrepareInstance keeps the count within an int
+	uint32_t objectCount = static_cast<uint32_t>(m_bufferInstance.size / sizeof(CelestialObj));
+	uint32_t clusterCount = (objectCount + OBJECTS_PER_GROUP - 1) / OBJECTS_PER_GROUP;
+	m_cull.clusterBuffer = CreateBuffer(clusterCount * 2 * sizeof(glm::vec4), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	//Only the reference system is drawn, each copy of it rounded up to whole clusters so a copy's objects start a cluster.
+	//At most that many instances survive, each bucket gets a section that size
+	m_cull.clusterCount = (m_ensemble.systemSize + OBJECTS_PER_GROUP - 1) / OBJECTS_PER_GROUP;
+	m_cull.sectionSize = AMPLIFY_COPIES * m_cull.clusterCount * OBJECTS_PER_GROUP;
+	m_cull.visibleBuffer = CreateBuffer(CULL_BUCKET_COUNT * m_cull.sectionSize * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	//Indexed by object and copy rather than by slot, so it stays one entry per object however the buckets fill
+	m_cull.renderBuffer = CreateBuffer(m_cull.sectionSize * sizeof(RenderInstance), vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	//One draw per bucket, its instances start at the bucket's section so gl_InstanceIndex indexes visible directly.
+	//The second phase appends to the same sections, cull.comp moves its firstInstance past what the first phase wrote
+	std::vector<vk::DrawIndexedIndirectCommand> drawCommands;
+	for (uint32_t phase = 0; phase < 2; phase++)
+	{
+		for (uint32_t bucket = 0; bucket < CULL_BUCKET_COUNT; bucket++)
+		{
+			const SolidSphere::Lod& mesh = bucket < SPHERE_LOD_COUNT ? m_sphere.GetLods()[bucket] : m_sphere.GetImpostorQuad();
+			drawCommands.push_back(vk::DrawIndexedIndirectCommand(mesh.indexCount, 0, mesh.firstIndex, mesh.vertexOffset, bucket * m_cull.sectionSize));
+		}
+	}
+	vk::DeviceSize drawSize = drawCommands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+	vko::Buffer drawStagingBuffer = CreateBuffer(drawSize, vk::BufferUsageFlagBits::eTransferSrc, drawCommands.data());
+	m_cull.drawBuffer = CreateBuffer(drawSize, vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(drawStagingBuffer, m_cull.drawBuffer, drawSize);
+	drawStagingBuffer.Destroy();
+
+	//Nothing was visible before the first frame, so it is all drawn by the second phase
+	vk::DeviceSize historySize = m_cull.sectionSize / 32 * sizeof(uint32_t);
+	std::vector<uint32_t> history(historySize / sizeof(uint32_t), 0);
+	vko::Buffer historyStagingBuffer = CreateBuffer(historySize, vk::BufferUsageFlagBits::eTransferSrc, history.data());
+	m_cull.historyBuffer = CreateBuffer(historySize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(historyStagingBuffer, m_cull.historyBuffer, historySize);
+	historyStagingBuffer.Destroy();
+
+	m_cull.statsBuffer = CreateBuffer(sizeof(CullStats), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+	m_cull.statsBuffer.Map();
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(9, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(10, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(11, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	m_cull.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPush));
+	m_cull.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_cull.descriptorSetLayout, 1, &pushConstantRange));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_cull.descriptorSetLayout);
+	m_cull.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferInstance.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.clusterBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.visibleBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.drawBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 4, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 7, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.historyBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 8, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_hiz.pyramid.descriptor), {}),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 9, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.statsBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 10, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_cull.renderBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_cull.descriptorSet, 11, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_aggregate.buffer.descriptor))
+	};
+
+	//Only the splatting build of the shader reads 5 and 6
+	if (m_splat.enabled)
+	{
+		writeSets.push_back(vk::WriteDescriptorSet(m_cull.descriptorSet, 5, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_splat.buffer.descriptor)));
+		writeSets.push_back(vk::WriteDescriptorSet(m_cull.descriptorSet, 6, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureArrayPlanets.descriptor), {}));
+	}
+
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	vk::ShaderModule cullShader = CompileShader(m_splat.enabled ? "resources/shaders/cull_splat.comp.spv" : "resources/shaders/cull.comp.spv");
+	vk::PipelineShaderStageCreateInfo computeShaderStage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, cullShader, "main");
+
+	//Same workgroup size as planets.comp so each workgroup tests the cluster it wrote, the phase picks which objects are drawn
+	for (uint32_t phase = 0; phase < 2; phase++)
+	{
+		uint32_t specData[] = { OBJECTS_PER_GROUP, phase + 1 };
+		vk::SpecializationMapEntry specEntries[] = {
+			vk::SpecializationMapEntry(0, 0, sizeof(uint32_t)),
+			vk::SpecializationMapEntry(1, sizeof(uint32_t), sizeof(uint32_t))
+		};
+		vk::SpecializationInfo specInfo = vk::SpecializationInfo(2, specEntries, sizeof(specData), specData);
+		computeShaderStage.pSpecializationInfo = &specInfo;
+
+		vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+		pipelineCreateInfo.layout = m_cull.pipelineLayout;
+		pipelineCreateInfo.stage = computeShaderStage;
+		m_cull.pipelines[phase] = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+	}
+
+	m_vulkanResources->device.destroyShaderModule(cullShader);
+}
+
+void OrreyVk::PrepareOrbits()
+{
+	if (m_orbits.trackedCount == 0)
+		return;
+
+	//Room for every tracked body at its most detailed, orbit.comp packs them from the start
+	vk::DeviceSize vertexSize = static_cast<vk::DeviceSize>(m_orbits.trackedCount) * ORBIT_MAX_SEGMENTS * 2 * sizeof(glm::vec4);
+	m_orbits.vertexBuffer = CreateBuffer(vertexSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	vk::DrawIndirectCommand drawCommand = vk::DrawIndirectCommand(0, 1, 0, 0);
+	vko::Buffer drawStagingBuffer = CreateBuffer(sizeof(drawCommand), vk::BufferUsageFlagBits::eTransferSrc, &drawCommand);
+	m_orbits.drawBuffer = CreateBuffer(sizeof(drawCommand), vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(drawStagingBuffer, m_orbits.drawBuffer, sizeof(drawCommand));
+	drawStagingBuffer.Destroy();
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	m_orbits.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(OrbitPush));
+	m_orbits.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_orbits.descriptorSetLayout, 1, &pushConstantRange));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_orbits.descriptorSetLayout);
+	m_orbits.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_orbits.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferInstance.descriptor)),
+		vk::WriteDescriptorSet(m_orbits.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_orbits.vertexBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_orbits.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_orbits.drawBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_orbits.descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_orbits.trackedBuffer.descriptor))
+	};
+
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	vk::ShaderModule orbitShader = CompileShader("resources/shaders/orbit.comp.spv");
+	vk::PipelineShaderStageCreateInfo computeShaderStage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, orbitShader, "main");
+
+	uint32_t groupSize = ORBIT_GROUP_SIZE;
+	vk::SpecializationMapEntry specEntry = vk::SpecializationMapEntry(0, 0, sizeof(uint32_t));
+	vk::SpecializationInfo specInfo = vk::SpecializationInfo(1, &specEntry, sizeof(uint32_t), &groupSize);
+	computeShaderStage.pSpecializationInfo = &specInfo;
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+	pipelineCreateInfo.layout = m_orbits.pipelineLayout;
+	pipelineCreateInfo.stage = computeShaderStage;
+	m_orbits.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	m_vulkanResources->device.destroyShaderModule(orbitShader);
+
+	spdlog::info("Orbits: Tracking {} bodies", m_orbits.trackedCount);
+}
+
+void OrreyVk::PreparePreview()
+{
+	//Control block then the selection and the perturbers, rewritten by the host between frames
+	m_preview.controlBuffer = CreateBuffer(sizeof(PreviewControl) + (PREVIEW_MAX_SELECTION + PREVIEW_MAX_PERTURBERS) * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer);
+	m_preview.controlBuffer.Map();
+
+	//Header of generation, steps done and front half then the clones, the zeroed header matches nothing having been built
+	uint32_t stateHeader[4] = {};
+	vk::DeviceSize stateSize = sizeof(stateHeader) + (PREVIEW_MAX_SELECTION * 2 + PREVIEW_MAX_PERTURBERS) * sizeof(CelestialObj);
+	vko::Buffer stateStagingBuffer = CreateBuffer(sizeof(stateHeader), vk::BufferUsageFlagBits::eTransferSrc, stateHeader);
+	m_preview.stateBuffer = CreateBuffer(stateSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(stateStagingBuffer, m_preview.stateBuffer, sizeof(stateHeader));
+	stateStagingBuffer.Destroy();
+
+	vk::DeviceSize vertexSize = 2 * PREVIEW_MAX_SELECTION * (PREVIEW_STEPS / PREVIEW_STEP_STRIDE) * 2 * sizeof(glm::vec4);
+	m_preview.vertexBuffer = CreateBuffer(vertexSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	vk::DrawIndirectCommand drawCommand = vk::DrawIndirectCommand(0, 1, 0, 0);
+	vko::Buffer drawStagingBuffer = CreateBuffer(sizeof(drawCommand), vk::BufferUsageFlagBits::eTransferSrc, &drawCommand);
+	m_preview.drawBuffer = CreateBuffer(sizeof(drawCommand), vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(drawStagingBuffer, m_preview.drawBuffer, sizeof(drawCommand));
+	drawStagingBuffer.Destroy();
+
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	m_preview.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+	m_preview.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_preview.descriptorSetLayout));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_preview.descriptorSetLayout);
+	m_preview.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_preview.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferInstance.descriptor)),
+		vk::WriteDescriptorSet(m_preview.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_preview.controlBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_preview.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_preview.stateBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_preview.descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_preview.vertexBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_preview.descriptorSet, 4, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_preview.drawBuffer.descriptor))
+	};
+
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	vk::ShaderModule previewShader = CompileShader("resources/shaders/preview.comp.spv");
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+	pipelineCreateInfo.layout = m_preview.pipelineLayout;
+	pipelineCreateInfo.stage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, previewShader, "main");
+	m_preview.pipeline = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+
+	m_vulkanResources->device.destroyShaderModule(previewShader);
+
+	UpdatePreviewControl();
+}
+
+void OrreyVk::UpdatePreviewControl()
+{
+	//Only read by the graphics queue, which is idle between frames
+	PreviewControl* control = static_cast<PreviewControl*>(m_preview.controlBuffer.mapped);
+	control->generation = m_preview.generation;
+	control->selectionCount = m_preview.enabled ? std::min<uint32_t>(m_preview.selection.size(), PREVIEW_MAX_SELECTION) : 0;
+	control->steps = PREVIEW_STEPS;
+	control->stepsPerFrame = PREVIEW_STEPS_PER_FRAME;
+	control->stride = PREVIEW_STEP_STRIDE;
+	control->scale = SCALE;
+	control->stepTime = m_compute.ubo.deltaT * m_compute.ubo.speed;
+	control->perturberCount = m_preview.perturbers.size();
+	uint32_t* selection = reinterpret_cast<uint32_t*>(control + 1);
+	std::copy(m_preview.selection.begin(), m_preview.selection.begin() + control->selectionCount, selection);
+	std::copy(m_preview.perturbers.begin(), m_preview.perturbers.end(), selection + PREVIEW_MAX_SELECTION);
+}
+
+void OrreyVk::TogglePreview()
+{
+	if (!m_preview.enabled)
+	{
+		//Parents are looked up by their local index, so only the reference system can be previewed
+		for (uint32_t index : m_preview.selection)
+		{
+			if (index == 0 || index >= m_ensemble.systemSize)
+			{
+				spdlog::error("Preview: Body {} can't be previewed, pick one of 1 to {}", index, m_ensemble.systemSize - 1);
+				return;
+			}
+		}
+		if (m_preview.selection.empty())
+		{
+			spdlog::error("Preview: Nothing selected");
+			return;
+		}
+		if (m_preview.selection.size() > PREVIEW_MAX_SELECTION)
+			spdlog::info("Preview: Only the first {} bodies are previewed", PREVIEW_MAX_SELECTION);
+	}
+
+	m_preview.enabled = !m_preview.enabled;
+	m_preview.generation++;
+	UpdatePreviewControl();
+	if (m_preview.enabled)
+		spdlog::info("Preview: Integrating {} steps ahead of {} bodies, {} per frame", PREVIEW_STEPS, std::min<size_t>(m_preview.selection.size(), PREVIEW_MAX_SELECTION), PREVIEW_STEPS_PER_FRAME);
+	else
+		spdlog::info("Preview: Off");
+}
+
+void OrreyVk::PrepareAggregates()
+{
+	//cull.comp always reads the buffer, it holds a single unused entry when there is nothing to aggregate
+	uint32_t aggregateCount = m_aggregate.populations.size();
+	std::vector<Aggregate> aggregates = m_aggregate.populations;
+	aggregates.resize(std::max<size_t>(aggregates.size(), 1));
+	vk::DeviceSize aggregateSize = aggregates.size() * sizeof(Aggregate);
+	vko::Buffer aggregateStagingBuffer = CreateBuffer(aggregateSize, vk::BufferUsageFlagBits::eTransferSrc, aggregates.data());
+	m_aggregate.buffer = CreateBuffer(aggregateSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	CopyBuffer(aggregateStagingBuffer, m_aggregate.buffer, aggregateSize);
+	aggregateStagingBuffer.Destroy();
+
+	if (aggregateCount == 0)
+	{
+		spdlog::info("Aggregates: No rings or belts of {} or more members, every member is drawn at any distance", AGGREGATE_MIN_COUNT);
+		return;
+	}
+
+	//Counted into on the first frame, before anything reads it
+	m_aggregate.densityBuffer = CreateBuffer(aggregateCount * AGGREGATE_BINS * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_aggregate.controlBuffer = CreateBuffer(sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer);
+	m_aggregate.controlBuffer.Map();
+
+	//aggregate.comp uses all but the sampler, the annulus reads the populations, their bins and the texture colour
+	std::vector<vk::DescriptorSetLayoutBinding> descSetLayoutBindings =
+	{
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment),
+		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex),
+		vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment)
+	};
+
+	m_aggregate.descriptorSetLayout = m_vulkanResources->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, descSetLayoutBindings.size(), descSetLayoutBindings.data()));
+
+	vk::PushConstantRange pushConstantRange = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(AggregatePush));
+	m_aggregate.pipelineLayout = m_vulkanResources->device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, 1, &m_aggregate.descriptorSetLayout, 1, &pushConstantRange));
+
+	vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo(m_vulkanResources->descriptorPool, 1, &m_aggregate.descriptorSetLayout);
+	m_aggregate.descriptorSet = m_vulkanResources->device.allocateDescriptorSets(allocInfo)[0];
+
+	std::vector<vk::WriteDescriptorSet> writeSets =
+	{
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_bufferInstance.descriptor)),
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_aggregate.buffer.descriptor)),
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_aggregate.densityBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 3, 0, 1, vk::DescriptorType::eUniformBuffer, {}, &(m_graphics.uniformBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 4, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_aggregate.controlBuffer.descriptor)),
+		vk::WriteDescriptorSet(m_aggregate.descriptorSet, 5, 0, 1, vk::DescriptorType::eCombinedImageSampler, &(m_textureArrayPlanets.descriptor), {})
+	};
+
+	m_vulkanResources->device.updateDescriptorSets(writeSets.size(), writeSets.data(), 0, nullptr);
+
+	vk::ShaderModule aggregateShader = CompileShader("resources/shaders/aggregate.comp.spv");
+	vk::PipelineShaderStageCreateInfo computeShaderStage = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, aggregateShader, "main");
+
+	//The pass picks whether the populations are placed and faded or their members binned
+	for (uint32_t pass = 0; pass < 2; pass++)
+	{
+		uint32_t specData = pass + 1;
+		vk::SpecializationMapEntry specEntry = vk::SpecializationMapEntry(0, 0, sizeof(uint32_t));
+		vk::SpecializationInfo specInfo = vk::SpecializationInfo(1, &specEntry, sizeof(uint32_t), &specData);
+		computeShaderStage.pSpecializationInfo = &specInfo;
+
+		vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo();
+		pipelineCreateInfo.layout = m_aggregate.pipelineLayout;
+		pipelineCreateInfo.stage = computeShaderStage;
+		m_aggregate.pipelines[pass] = m_vulkanResources->device.createComputePipeline(nullptr, pipelineCreateInfo);
+	}
+
+	m_vulkanResources->device.destroyShaderModule(aggregateShader);
+
+	CreateAggregatePipeline();
+	UpdateAggregateControl();
+
+	uint32_t memberCount = 0;
+	for (const Aggregate& aggregate : m_aggregate.populations)
+		memberCount += aggregate.count;
+	spdlog::info("Aggregates: {} rings and belts of {} members fade into a density annulus from a distance", aggregateCount, memberCount);
+}
+
+void OrreyVk::CreateAggregatePipeline()
+{
+	//Annulus pipeline - generated from the vertex index, blended over the scene and depth tested without writing depth
+	vk::ShaderModule vertShader = CompileShader("resources/shaders/aggregate.vert.spv");
+	vk::ShaderModule fragShader = CompileShader("resources/shaders/aggregate.frag.spv");
+	vk::PipelineShaderStageCreateInfo shaderStages[] = {
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertShader, "main"),
+		vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragShader, "main")
+	};
+
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo();
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo({}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+
+	vk::Viewport viewport = vk::Viewport(0.0, 0.0, m_renderExtent.width, m_renderExtent.height, 0.0, 1.0);
+	vk::Rect2D scissor = vk::Rect2D({ 0,0 }, m_renderExtent);
+	vk::PipelineViewportStateCreateInfo viewPortState = vk::PipelineViewportStateCreateInfo({}, 1, &viewport, 1, &scissor);
+
+	//Seen from either side
+	vk::PipelineRasterizationStateCreateInfo rastierizer = vk::PipelineRasterizationStateCreateInfo();
+	rastierizer.cullMode = vk::CullModeFlagBits::eNone;
+
+	vk::PipelineMultisampleStateCreateInfo msState = vk::PipelineMultisampleStateCreateInfo();
+	msState.rasterizationSamples = m_msaaSamples;
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo = vk::PipelineDepthStencilStateCreateInfo({}, VK_TRUE, VK_FALSE, vk::CompareOp::eLess);
+
+	vk::PipelineColorBlendAttachmentState colourBlendAttachState = vk::PipelineColorBlendAttachmentState();
+	colourBlendAttachState.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	colourBlendAttachState.blendEnable = VK_TRUE;
+	colourBlendAttachState.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+	colourBlendAttachState.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+	colourBlendAttachState.colorBlendOp = vk::BlendOp::eAdd;
+	colourBlendAttachState.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+	colourBlendAttachState.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+	colourBlendAttachState.alphaBlendOp = vk::BlendOp::eAdd;
+	vk::PipelineColorBlendStateCreateInfo colourBlendInfo = vk::PipelineColorBlendStateCreateInfo();
+	colourBlendInfo.pAttachments = &colourBlendAttachState;
+	colourBlendInfo.attachmentCount = 1;
+
+	vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo();
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewPortState;
+	pipelineInfo.pRasterizationState = &rastierizer;
+	pipelineInfo.pMultisampleState = &msState;
+	pipelineInfo.pDepthStencilState = &depthStencilInfo;
+	pipelineInfo.pColorBlendState = &colourBlendInfo;
+	pipelineInfo.layout = m_aggregate.pipelineLayout;
+	pipelineInfo.renderPass = m_vulkanResources->renderpass;
+	pipelineInfo.subpass = 0;
+
+	m_aggregate.drawPipeline = m_vulkanResources->device.createGraphicsPipeline(nullptr, pipelineInfo);
+
+	m_vulkanResources->device.destroyShaderModule(vertShader);
+	m_vulkanResources->device.destroyShaderModule(fragShader);
+}
+
+void OrreyVk::UpdateAggregateControl()
+{
+	if (m_aggregate.populations.empty())
+		return;
+
+	//Only read by the graphics queue, which is idle between frames
+	*static_cast<uint32_t*>(m_aggregate.controlBuffer.mapped) = m_aggregate.frame % AGGREGATE_REBIN_INTERVAL == 0 ? 1 : 0;
+	m_aggregate.frame++;
+}
+
+void OrreyVk::RequestCheckpoint()
+{
+	if (m_checkpoint.state != CheckpointState::eIdle)
+	{
+		spdlog::warn("Checkpoint: Already saving");
+		return;
+	}
+
+	if (m_checkpoint.readbackBuffer.size != m_bufferInstance.size)
+	{
+		m_checkpoint.readbackBuffer.Destroy();
+		m_checkpoint.readbackBuffer = CreateBuffer(m_bufferInstance.size, vk::BufferUsageFlagBits::eTransferDst, nullptr, GetReadbackMemoryFlags());
+		m_checkpoint.readbackBuffer.Map();
+	}
+
+	m_checkpoint.header = sim::CheckpointHeader();
+	m_checkpoint.header.objectCount = m_bufferInstance.size / sizeof(CelestialObj);
+	m_checkpoint.header.systemCount = m_ensemble.systemCount;
+	m_checkpoint.header.systemSize = m_ensemble.systemSize;
+	m_checkpoint.header.params.deltaT = m_compute.ubo.deltaT;
+	m_checkpoint.header.params.speed = m_compute.ubo.speed;
+	m_checkpoint.header.params.scale = m_compute.ubo.scale;
+	m_checkpoint.header.params.systemSize = m_ensemble.systemSize;
+	m_checkpoint.requestTime = std::chrono::high_resolution_clock::now();
+	m_checkpoint.state = CheckpointState::eRequested;
+}
+
+void OrreyVk::PollCheckpoint()
+{
+	switch (m_checkpoint.state)
+	{
+	case CheckpointState::eInFlight:
+		//A later submit means the fence has already been waited on, otherwise ask it directly
+		if (IsComputeSubmitComplete(m_checkpoint.submitIndex))
+		{
+			m_checkpoint.writer = std::async(std::launch::async, sim::WriteCheckpoint, m_checkpoint.path, m_checkpoint.header,
+				static_cast<const CelestialObj*>(m_checkpoint.readbackBuffer.mapped));
+			m_checkpoint.state = CheckpointState::eWriting;
+		}
+		break;
+	case CheckpointState::eWriting:
+		if (m_checkpoint.writer.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			if (m_checkpoint.writer.get())
+				spdlog::info("Checkpoint: Saved {} objects at t = {} to {} in {}ms", m_checkpoint.header.objectCount, m_checkpoint.header.simulationTime, m_checkpoint.path,
+					std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_checkpoint.requestTime).count());
+			else
+				spdlog::error("Checkpoint: Failed to write {}", m_checkpoint.path);
+			m_checkpoint.state = CheckpointState::eIdle;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+bool OrreyVk::IsComputeSubmitComplete(uint64_t submitIndex)
+{
+	//Later submits only start once the fence for this one has been waited on
+	return m_compute.submitCount > submitIndex || m_vulkanResources->device.getFenceStatus(m_compute.fence) == vk::Result::eSuccess;
+}
+
+void OrreyVk::ToggleRecording()
+{
+	if (m_recording.recorder)
+	{
+		//Flushes everything already handed to the writer
+		m_recording.recorder.reset();
+		for (uint32_t i = 0; i < RECORD_RING_SIZE; i++)
+			m_recording.slots[i].inFlight = false;
+		m_recording.pendingSlot = -1;
+		spdlog::info("Recorder: Stopped, saved to {} ({} snapshots dropped)", m_recording.path, m_recording.dropped);
+		return;
+	}
+
+	uint32_t objectCount = m_bufferInstance.size / sizeof(CelestialObj);
+	for (uint32_t index : m_recording.selection)
+	{
+		if (index >= objectCount)
+		{
+			spdlog::error("Recorder: Body {} is out of range, there are {} objects", index, objectCount);
+			return;
+		}
+	}
+
+	bool recordAll = m_recording.selection.empty();
+	uint32_t bodyCount = recordAll ? objectCount : m_recording.selection.size();
+	vk::DeviceSize slotSize = bodyCount * sizeof(glm::vec4);
+
+	if (recordAll && !m_recording.packedBuffer.buffer)
+	{
+		m_vulkanResources->device.waitIdle();
+		m_recording.packedBuffer = CreateBuffer(slotSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		vk::WriteDescriptorSet writeSet = vk::WriteDescriptorSet(m_compute.descriptorSet, 5, 0, 1, vk::DescriptorType::eStorageBuffer, {}, &(m_recording.packedBuffer.descriptor));
+		m_vulkanResources->device.updateDescriptorSets(1, &writeSet, 0, nullptr);
+	}
+
+	if (!m_recording.slots || m_recording.slots[0].buffer.size != slotSize)
+	{
+		if (!m_recording.slots)
+			m_recording.slots.reset(new RecordSlot[RECORD_RING_SIZE]);
+		m_vulkanResources->device.waitIdle();
+		for (uint32_t i = 0; i < RECORD_RING_SIZE; i++)
+		{
+			m_recording.slots[i].buffer.Destroy();
+			m_recording.slots[i].buffer = CreateBuffer(slotSize, vk::BufferUsageFlagBits::eTransferDst, nullptr, GetReadbackMemoryFlags());
+			m_recording.slots[i].buffer.Map();
+		}
+	}
+
+	m_recording.recorder.reset(new sim::TrajectoryRecorder(m_recording.path, bodyCount));
+	if (!m_recording.recorder->IsOpen())
+	{
+		m_recording.recorder.reset();
+		return;
+	}
+	m_recording.nextSlot = 0;
+	m_recording.dropped = 0;
+	spdlog::info("Recorder: Recording {} bodies every {} steps to {}", bodyCount, RECORD_STEP_INTERVAL, m_recording.path);
+}
+
+void OrreyVk::PollRecording()
+{
+	if (!m_recording.recorder)
+		return;
+
+	//Oldest first so snapshots reach the writer in step order
+	for (uint32_t i = 0; i < RECORD_RING_SIZE; i++)
+	{
+		RecordSlot& slot = m_recording.slots[(m_recording.nextSlot + i) % RECORD_RING_SIZE];
+		if (!slot.inFlight || !IsComputeSubmitComplete(slot.submitIndex))
+			continue;
+
+		slot.inFlight = false;
+		slot.writing = true;
+		m_recording.recorder->Submit(slot.step, slot.simulationTime, slot.buffer.mapped, sizeof(glm::vec4), [&slot]() { slot.writing = false; });
+	}
+}
+
+void OrreyVk::PrepareTimeline()
+{
+	uint32_t objectCount = m_bufferInstance.size / sizeof(CelestialObj);
+	m_timeline.keyframeSize = objectCount * KEYFRAME_STRIDE * sizeof(uint32_t);
+
+	//The whole ring is bound as one storage buffer
+	vk::DeviceSize budget = std::min<vk::DeviceSize>(KEYFRAME_MEMORY_BUDGET_MB * 1024ull * 1024ull, m_vulkanResources->physicalDevice.getProperties().limits.maxStorageBufferRange);
+	uint32_t capacity = budget / m_timeline.keyframeSize;
+	if (capacity < 2)
+	{
+		spdlog::warn("Timeline: {:.1f}MB keyframes do not fit twice in {:.1f}MB, rewinding is disabled", m_timeline.keyframeSize / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+		m_timeline.ringBuffer = CreateBuffer(sizeof(uint32_t) * KEYFRAME_STRIDE, vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		return;
+	}
+
+	m_timeline.keyframes.resize(capacity);
+	m_timeline.ringBuffer = CreateBuffer(capacity * m_timeline.keyframeSize, vk::BufferUsageFlagBits::eStorageBuffer, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	spdlog::info("Timeline: {} keyframes every {} steps, {:.1f}MB each ({}B per object instead of {}B), {:.1f}MB of {}MB budget used",
+		capacity, KEYFRAME_STEP_INTERVAL, m_timeline.keyframeSize / (1024.0 * 1024.0), KEYFRAME_STRIDE * sizeof(uint32_t), sizeof(CelestialObj),
+		m_timeline.ringBuffer.size / (1024.0 * 1024.0), KEYFRAME_MEMORY_BUDGET_MB);
+}
+
+void OrreyVk::Seek(double simulationTime)
+{
+	if (m_timeline.keyframes.empty() || simulationTime >= m_simulationTime)
+		return;
+
+	//Latest keyframe at or before the target, or the oldest one if the target has already left the ring
+	int32_t slot = -1;
+	int32_t oldest = -1;
+	for (uint32_t i = 0; i < m_timeline.keyframes.size(); i++)
+	{
+		const KeyframeInfo& keyframe = m_timeline.keyframes[i];
+		if (!keyframe.valid)
+			continue;
+		if (keyframe.simulationTime <= simulationTime && (slot < 0 || keyframe.step > m_timeline.keyframes[slot].step))
+			slot = i;
+		if (oldest < 0 || keyframe.step < m_timeline.keyframes[oldest].step)
+			oldest = i;
+	}
+	if (oldest < 0)
+		return;
+	if (slot < 0)
+	{
+		slot = oldest;
+		spdlog::warn("Timeline: t = {} is older than the oldest keyframe, seeking to t = {}", simulationTime, m_timeline.keyframes[slot].simulationTime);
+	}
+
+	//Replay the recorded step times until the next one would overshoot
+	const KeyframeInfo& keyframe = m_timeline.keyframes[slot];
+	uint64_t step = keyframe.step;
+	double time = keyframe.simulationTime;
+	m_timeline.seekSteps.clear();
+	while (step < m_timeline.step && time + m_timeline.stepTimes[step - m_timeline.firstStep] <= simulationTime)
+	{
+		m_timeline.seekSteps.push_back(m_timeline.stepTimes[step - m_timeline.firstStep]);
+		time += m_timeline.seekSteps.back();
+		step++;
+	}
+
+	//The timeline continues from here, later keyframes no longer apply
+	for (KeyframeInfo& info : m_timeline.keyframes)
+		if (info.valid && info.step > keyframe.step)
+			info.valid = false;
+	m_timeline.nextSlot = (slot + 1) % m_timeline.keyframes.size();
+	m_timeline.stepTimes.resize(step - m_timeline.firstStep);
+	m_timeline.step = step;
+
+	m_timeline.seekSlot = slot;
+	m_timeline.seekTime = time;
+	m_timeline.seekPending = true;
+	m_simulationTime = time;
+	spdlog::info("Timeline: Seeking to t = {} from the keyframe at t = {}, fast forwarding {} steps", time, keyframe.simulationTime, m_timeline.seekSteps.size());
+}
+
+void OrreyVk::PollTimeline()
+{
+	if (m_timeline.captureSubmitIndex == 0 || !IsComputeSubmitComplete(m_timeline.captureSubmitIndex))
+		return;
+
+	m_timeline.captureTime = GetTimeQueryResult(m_queueIDs.compute.timestampValidBits, 2);
+	m_timeline.captureSubmitIndex = 0;
+}
+
+void OrreyVk::ReadEnsembleDiagnostics()
+{
+	//Wait for the step in flight so every system is read back from the same step
+	m_vulkanResources->device.waitForFences(m_compute.fence, true, UINT64_MAX);
+
+	std::vector<SystemDiagnostics> diagnostics(m_ensemble.systemCount);
+	memcpy(diagnostics.data(), m_ensemble.diagnosticsBuffer.mapped, diagnostics.size() * sizeof(SystemDiagnostics));
+
+	for (uint32_t i = 0; i < m_ensemble.systemCount; i++)
+	{
+		float initialEnergy = m_ensemble.initialDiagnostics[i].energy.z;
+		float initialMomentum = m_ensemble.initialDiagnostics[i].momentum.y;
+		spdlog::info("System {}: E = {}, dE/E0 = {}, L = {}, dL/L0 = {}", i,
+			diagnostics[i].energy.z, (diagnostics[i].energy.z - initialEnergy) / initialEnergy,
+			diagnostics[i].momentum.y, (diagnostics[i].momentum.y - initialMomentum) / initialMomentum);
+	}
+}
+
+void OrreyVk::RunWorkerBenchmark(uint32_t maxWorkers, uint32_t steps, uint32_t astroidBeltObjectCount)
+{
+	sim::Scenario scenario;
+	if (!sim::LoadScenario(m_scenarioPath, scenario))
+		return;
+
+	//The astroid count replaces the size of the largest population, workers split a single system
+	auto largest = std::max_element(scenario.populations.begin(), scenario.populations.end(),
+		[](const sim::ScenarioPopulation& a, const sim::ScenarioPopulation& b) { return a.count < b.count; });
+	if (largest != scenario.populations.end())
+		largest->count = astroidBeltObjectCount;
+	std::vector<CelestialObj> objects(scenario.GetObjectCount());
+	sim::GenerateScenario(scenario, SCALE, 0, 0.0f, objects.data());
+	m_ensemble.systemSize = objects.size();
+
+	sim::StepParams params;
+	params.deltaT = 1.0f / 60.0f;
+	params.speed = m_speed;
+	params.scale = SCALE;
+	params.systemSize = m_ensemble.systemSize;
+
+	//Explicit bodies are massive, population members are test particles
+	sim::RunScalingBenchmark(objects, scenario.bodies.size(), params, maxWorkers, steps);
+}
+
+double OrreyVk::GetTimeQueryResult(uint32_t timeStampValidBits, uint32_t firstQuery)
+{
+	std::array<std::uint64_t, 2> timeStamps = { {0} };
+	m_vulkanResources->device.getQueryPoolResults<std::uint64_t>(m_queryPool, firstQuery, 2, timeStamps, sizeof(std::uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
 
 	std::transform(
 		timeStamps.begin(), timeStamps.end(), timeStamps.begin(),
@@ -697,6 +3296,18 @@ void OrreyVk::MainLoop() {
 		glfwPollEvents();
 		RenderFrame();		
 
+		//RenderFrame has waited for the graphics queue, both render passes and the post pass are timed
+		double gpuTime = 0.0;
+		if (m_queueIDs.graphics.timestampValidBits > 0)
+		{
+			double sceneTime = GetTimeQueryResult(m_queueIDs.graphics.timestampValidBits, 4);
+			double postTime = GetTimeQueryResult(m_queueIDs.graphics.timestampValidBits, 5);
+			m_aa.sceneTime += sceneTime;
+			m_aa.postTime += postTime;
+			m_aa.timedFrames++;
+			gpuTime = sceneTime + postTime;
+		}
+
 		double xPos, yPos;
 		glfwGetCursorPos(m_window, &xPos, &yPos);
 
@@ -711,8 +3322,16 @@ void OrreyVk::MainLoop() {
 
 		if (m_camera.viewUpdated)
 			UpdateCameraUniformBuffer();
+		UpdateAntiAliasing();
 
+		//Before the compute uniforms, which are split over however many substeps it leaves
+		UpdateGovernor(gpuTime);
 		UpdateComputeUniformBuffer();
+		UpdatePreviewControl();
+		UpdateAggregateControl();
+		PollCheckpoint();
+		PollRecording();
+		PollTimeline();
 
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -722,6 +3341,37 @@ void OrreyVk::MainLoop() {
 		if (m_totalRunTime >= m_seconds)
 		{
 			//spdlog::info("\tRuntime = {}", m_seconds);
+			if (m_ensemble.systemCount > 1)
+				ReadEnsembleDiagnostics();
+			if (!m_timeline.keyframes.empty() && static_cast<int>(m_seconds) % 10 == 0)
+			{
+				uint32_t keyframeCount = 0;
+				double oldestTime = m_simulationTime;
+				for (const KeyframeInfo& keyframe : m_timeline.keyframes)
+				{
+					if (keyframe.valid)
+					{
+						keyframeCount++;
+						oldestTime = std::min(oldestTime, keyframe.simulationTime);
+					}
+				}
+				spdlog::info("Timeline: {}/{} keyframes, {:.1f}MB, rewind window {:.1f} days, last capture {:.3f}ms",
+					keyframeCount, m_timeline.keyframes.size(), keyframeCount * m_timeline.keyframeSize / (1024.0 * 1024.0), m_simulationTime - oldestTime, m_timeline.captureTime);
+			}
+			if (static_cast<int>(m_seconds) % 10 == 0)
+			{
+				//Written by the last frame, which RenderFrame has waited on
+				const CullStats* cullStats = static_cast<const CullStats*>(m_cull.statsBuffer.mapped);
+				spdlog::info("Culling: {} in view, {} occluded, {} drawn first, {} drawn second, {} splatted",
+					cullStats->tested, cullStats->occluded, cullStats->firstPhase, cullStats->secondPhase, cullStats->splatted);
+				ReportAntiAliasingCost();
+			}
+			if (m_recording.recorder)
+			{
+				sim::TrajectoryRecorder::Stats stats = m_recording.recorder->GetStats();
+				spdlog::info("Recorder: {:.1f}MB/s captured, {:.1f}MB/s written, backlog {}, {} chunks, {} dropped",
+					stats.inputBandwidth, stats.outputBandwidth, stats.backlog, stats.chunks, m_recording.dropped);
+			}
 			m_seconds += 1;
 		}
 	}
@@ -729,29 +3379,100 @@ void OrreyVk::MainLoop() {
 
 void OrreyVk::Cleanup() {
 	m_vulkanResources->device.waitIdle();
+	DestroyRenderTargetResources();
 	m_bufferVertex.Destroy();
 	m_bufferIndex.Destroy();
 	m_bufferInstance.Destroy();
-	m_orbitVertexInfo.m_bufferVertexOrbit.Destroy();
+	m_orbits.trackedBuffer.Destroy();
+	m_orbits.vertexBuffer.Destroy();
+	m_orbits.drawBuffer.Destroy();
+	m_vulkanResources->device.destroyDescriptorSetLayout(m_orbits.descriptorSetLayout);
+	m_vulkanResources->device.destroyPipeline(m_orbits.pipeline);
+	m_vulkanResources->device.destroyPipelineLayout(m_orbits.pipelineLayout);
+	if (m_splat.enabled)
+	{
+		m_splat.buffer.Destroy();
+		m_vulkanResources->device.destroyDescriptorSetLayout(m_splat.descriptorSetLayout);
+		m_vulkanResources->device.destroyPipelineLayout(m_splat.pipelineLayout);
+	}
+	m_cull.clusterBuffer.Destroy();
+	m_cull.visibleBuffer.Destroy();
+	m_cull.renderBuffer.Destroy();
+	m_cull.drawBuffer.Destroy();
+	m_cull.historyBuffer.Destroy();
+	m_cull.statsBuffer.Destroy();
+	m_vulkanResources->device.destroyDescriptorSetLayout(m_cull.descriptorSetLayout);
+	for (vk::Pipeline pipeline : m_cull.pipelines)
+		m_vulkanResources->device.destroyPipeline(pipeline);
+	m_vulkanResources->device.destroyPipelineLayout(m_cull.pipelineLayout);
+
+	m_vulkanResources->device.destroySampler(m_hiz.depthSampler);
+	m_vulkanResources->device.destroyDescriptorSetLayout(m_hiz.descriptorSetLayout);
+	m_vulkanResources->device.destroyPipelineLayout(m_hiz.pipelineLayout);
+	if (m_visibility.enabled)
+	{
+		m_visibility.image.Destroy();
+		m_vulkanResources->device.destroyRenderPass(m_visibility.renderpass);
+		m_vulkanResources->device.destroyRenderPass(m_visibility.renderpassLoad);
+		m_vulkanResources->device.destroyPipeline(m_visibility.pipeline);
+		m_vulkanResources->device.destroyPipeline(m_visibility.pipelineImpostors);
+		m_vulkanResources->device.destroyPipelineLayout(m_visibility.pipelineLayout);
+		m_vulkanResources->device.destroyDescriptorSetLayout(m_visibility.shadeDescriptorSetLayout);
+		m_vulkanResources->device.destroyPipelineLayout(m_visibility.shadePipelineLayout);
+	}
+	m_aa.uniformBuffer.Destroy();
+	m_vulkanResources->device.destroySampler(m_aa.sampler);
+	m_vulkanResources->device.destroyDescriptorSetLayout(m_aa.descriptorSetLayout);
+	m_vulkanResources->device.destroyPipeline(m_aa.fxaaPipeline);
+	m_vulkanResources->device.destroyPipeline(m_aa.taaPipeline);
+	m_vulkanResources->device.destroyPipelineLayout(m_aa.pipelineLayout);
+	m_preview.controlBuffer.Destroy();
+	m_preview.stateBuffer.Destroy();
+	m_preview.vertexBuffer.Destroy();
+	m_preview.drawBuffer.Destroy();
+	m_vulkanResources->device.destroyDescriptorSetLayout(m_preview.descriptorSetLayout);
+	m_vulkanResources->device.destroyPipeline(m_preview.pipeline);
+	m_vulkanResources->device.destroyPipelineLayout(m_preview.pipelineLayout);
+	m_aggregate.buffer.Destroy();
+	if (!m_aggregate.populations.empty())
+	{
+		m_aggregate.densityBuffer.Destroy();
+		m_aggregate.controlBuffer.Destroy();
+		m_vulkanResources->device.destroyDescriptorSetLayout(m_aggregate.descriptorSetLayout);
+		for (vk::Pipeline pipeline : m_aggregate.pipelines)
+			m_vulkanResources->device.destroyPipeline(pipeline);
+		m_vulkanResources->device.destroyPipelineLayout(m_aggregate.pipelineLayout);
+	}
 	m_textureArrayPlanets.Destroy();
 	m_textureStarfield.Destroy();
 
 	m_graphics.uniformBuffer.Destroy();
 	m_vulkanResources->device.destroyDescriptorSetLayout(m_graphics.descriptorSetLayout);
 
-	m_vulkanResources->device.destroyPipeline(m_graphics.pipelinePlanets.pipeline);
-	m_vulkanResources->device.destroyPipeline(m_graphics.pipelineOrbits.pipeline);
-	m_vulkanResources->device.destroyPipeline(m_graphics.pipelineSkySphere.pipeline);
 	m_vulkanResources->device.destroyPipelineLayout(m_graphics.pipelinePlanets.layout);
 	m_vulkanResources->device.destroyPipelineLayout(m_graphics.pipelineOrbits.layout);
-	m_vulkanResources->device.destroyPipelineLayout(m_graphics.pipelineSkySphere.layout);
 
 	m_vulkanResources->device.destroySemaphore(m_graphics.semaphore);
 
 	m_compute.uniformBuffer.Destroy();
+	m_ensemble.diagnosticsBuffer.Destroy();
+	if (m_checkpoint.writer.valid())
+		m_checkpoint.writer.wait();
+	m_checkpoint.readbackBuffer.Destroy();
+	m_timeline.ringBuffer.Destroy();
+	m_recording.recorder.reset();
+	if (m_recording.slots)
+		for (uint32_t i = 0; i < RECORD_RING_SIZE; i++)
+			m_recording.slots[i].buffer.Destroy();
+	m_recording.packedBuffer.Destroy();
 	m_compute.commandPool.Destroy();
 	m_vulkanResources->device.destroyDescriptorSetLayout(m_compute.descriptorSetLayout);
 	m_vulkanResources->device.destroyPipeline(m_compute.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_ensemble.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_timeline.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_population.pipeline);
+	m_vulkanResources->device.destroyPipeline(m_recording.pipeline);
+	m_vulkanResources->device.destroyFence(m_compute.fence);
 	m_vulkanResources->device.destroyPipelineLayout(m_compute.pipelineLayout);
 	m_vulkanResources->device.destroySemaphore(m_compute.semaphore);
 	Vulkan::Cleanup();
@@ -7,6 +7,15 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 #include "Vulkan.h"
+#include "DistributedSimulation.h"
+#include "Checkpoint.h"
+#include "TrajectoryRecorder.h"
+#include "Scenario.h"
+#include <future>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <deque>
 
 class OrreyVk : Vulkan {
 public:
@@ -16,6 +25,22 @@ public:
 	void MainLoop();
 	void Cleanup();
 	void UpdateCamera(float xPos, float yPos, float deltaTime);
+	void RunWorkerBenchmark(uint32_t maxWorkers, uint32_t steps, uint32_t astroidBeltObjectCount);
+	void RestoreCheckpoint(const std::string& path) { m_checkpoint.restorePath = path; }
+	void SetScenario(const std::string& path) { m_scenarioPath = path; }
+	void SetEnsembleSize(uint32_t count) { m_ensemble.requestedCount = count; }
+	void RequestCheckpoint();
+	void SetRecordingSelection(const std::vector<uint32_t>& selection) { m_recording.selection = selection; }
+	void ToggleRecording();
+	void Seek(double simulationTime);
+	void SetPreviewSelection(const std::vector<uint32_t>& selection) { m_preview.selection = selection; }
+	void TogglePreview();
+	void CycleAntiAliasing();
+	void SetFrameBudget(float milliseconds) { m_governor.budget = milliseconds; }
+	void SetViewCount(uint32_t count) { m_multiview.count = count; }
+	void SetEyeSeparation(float separation) { m_multiview.eyeSeparation = separation; }
+	void PinGovernorKnob(const std::string& name, float value);
+	double GetSimulationTime() { return m_simulationTime; }
 	
 	struct {
 		glm::vec2 mousePos = glm::vec2();
@@ -41,11 +66,12 @@ public:
 private:
 	GLFWwindow * m_window;
 	SolidSphere m_sphere;
-	SolidSphere m_skySphere;
 
 	float m_frameTime = 1.0f;
 	float m_totalRunTime = 0.0f;
 	float m_seconds = 1.0f;
+	double m_simulationTime = 0.0;
+	std::string m_scenarioPath = "resources/scenarios/solar_system.txt";
 
 	struct PipelineInfo
 	{
@@ -53,23 +79,36 @@ private:
 		vk::Pipeline pipeline;
 	};
 
+	struct ViewMatrices { //Must match views.glsl
+		glm::mat4 view;
+		glm::mat4 viewProjection;
+	};
+
 	struct {
 		struct {
 			glm::mat4 projection;
 			glm::mat4 model;
-			glm::mat4 view;
+			glm::mat4 view; //The camera, culling and every view is placed from it
+			glm::mat4 viewProjection; //projection * view * model, so the vertex shaders do one multiply
+			ViewMatrices views[4]; //Picked by gl_ViewIndex, the first m_viewCount are set. Must match MULTIVIEW_MAX_VIEWS
 		} ubo;
 
 		vko::Buffer uniformBuffer;
 		vk::DescriptorSetLayout descriptorSetLayout;
 		vk::DescriptorSet descriptorSet;
-		vk::DescriptorSet skySphereDescriptorSet;
+		vk::DescriptorSet skyDescriptorSet;
 		PipelineInfo pipelinePlanets;
 		PipelineInfo pipelineOrbits;
-		PipelineInfo pipelineSkySphere;
+		PipelineInfo pipelineSky; //Shares the planets layout
+		PipelineInfo pipelineImpostors; //Shares the planets layout
 		vk::Semaphore semaphore;
 	} m_graphics;
 
+	struct {
+		uint32_t count = 0; //Views asked for with --views, MULTIVIEW_COUNT unless set
+		float eyeSeparation = -1.0f; //MULTIVIEW_EYE_SEPARATION unless set with --eye-separation
+	} m_multiview;
+
 	struct {
 		vko::Buffer uniformBuffer;
 		vko::VulkanCommandPool commandPool;
@@ -79,40 +118,321 @@ private:
 		vk::PipelineLayout pipelineLayout;
 		vk::Pipeline pipeline;
 		vk::Semaphore semaphore;
+		vk::Fence fence;
+		uint64_t submitCount = 0;
+		bool rerecord = false; //Set when the command buffer holds one off work and has to be recorded again before the next step
 		struct {
 			float deltaT;
 			int32_t objectCount;
 			int32_t scale;
 			float speed;
+			int32_t systemSize;
+			int32_t systemCount;
 		} ubo;
 	} m_compute;
 
-	struct CelestialObj {
-		glm::vec4 position; //xyz Position, w Mass
-		glm::vec4 velocity; //xyz Velocity
-		glm::vec4 scale;	//xyz Scale w texIndex
-		glm::vec4 rotation; //xyz Current rotation on each axis
-		glm::vec4 rotationSpeed; //xyz Rotation speed for each axis
-		glm::vec4 posOffset; //If w != 0 then object is a moon and this describes the position of the object it is orbiting
-		glm::vec4 orbitalTilt; //xyz Angle of tilt for the orbital plane
-		glm::vec4 colourTint = glm::vec4(1.0);
+	struct SystemDiagnostics {
+		glm::vec4 energy; //x Kinetic, y Potential, z Total
+		glm::vec4 momentum; //y Angular momentum about the sun, w Number of heliocentric bodies
+	};
+
+	struct {
+		uint32_t systemCount = 1;
+		uint32_t systemSize = 0;
+		uint32_t requestedCount = 0; //Systems asked for with --ensemble, ENSEMBLE_SYSTEM_COUNT unless set
+		vko::Buffer diagnosticsBuffer;
+		vk::Pipeline pipeline;
+		std::vector<SystemDiagnostics> initialDiagnostics; //Read back before the first step
+	} m_ensemble;
+
+	struct {
+		vk::Pipeline pipeline;
+		std::vector<sim::PopulationParams> pending; //Generated by the first compute submit
+	} m_population;
+
+	enum class CheckpointState { eIdle, eRequested, eRecorded, eInFlight, eWriting };
+
+	struct {
+		CheckpointState state = CheckpointState::eIdle;
+		std::string path = "orreyvk.chk";
+		std::string restorePath;
+		vko::Buffer readbackBuffer;
+		sim::CheckpointHeader header;
+		uint64_t submitIndex = 0;
+		std::future<bool> writer;
+		std::chrono::high_resolution_clock::time_point requestTime;
+	} m_checkpoint;
+
+	struct RecordSlot {
+		vko::Buffer buffer;
+		bool inFlight = false; //Copy submitted, waiting on the compute fence
+		std::atomic<bool> writing{ false }; //Handed to the recorder, cleared from its writer thread
+		uint64_t submitIndex = 0;
+		uint64_t step = 0;
+		double simulationTime = 0.0;
+	};
+
+	struct {
+		std::string path = "orreyvk.trj";
+		std::vector<uint32_t> selection; //Bodies to record, all of them if empty
+		std::unique_ptr<sim::TrajectoryRecorder> recorder;
+		std::unique_ptr<RecordSlot[]> slots;
+		vko::Buffer packedBuffer; //Device local, every position packed by record.comp when recording everything
+		vk::Pipeline pipeline;
+		uint32_t nextSlot = 0;
+		int32_t pendingSlot = -1; //Slot copied to by the command buffer being recorded
+		uint64_t dropped = 0; //Captures skipped because every slot was still busy
+	} m_recording;
+
+	struct KeyframeInfo {
+		bool valid = false;
+		uint64_t step = 0;
+		double simulationTime = 0.0;
+	};
+
+	struct {
+		vko::Buffer ringBuffer; //Device local, keyframeSize bytes per slot
+		vk::Pipeline pipeline;
+		vk::DeviceSize keyframeSize = 0;
+		std::vector<KeyframeInfo> keyframes;
+		uint32_t nextSlot = 0;
+		uint64_t step = 0; //Steps taken to reach the current state
+		uint64_t firstStep = 0; //Step of the oldest keyframe, stepTimes starts here
+		std::deque<float> stepTimes; //deltaT * speed of every step since the oldest keyframe
+		int32_t captureSlot = -1;
+		uint64_t captureSubmitIndex = 0;
+		double captureTime = 0.0; //ms of GPU time for the last capture
+		bool seekPending = false;
+		int32_t seekSlot = -1;
+		std::vector<float> seekSteps; //Steps to fast forward after restoring seekSlot
+		double seekTime = 0.0;
+	} m_timeline;
+
+	struct CullPush {
+		uint32_t objectCount;
+		float minPixelSize;
+		float viewportHeight;
+		float lodPixelSize;
+		float impostorPixelSize;
+		uint32_t viewportWidth;
+		uint32_t aggregateCount;
+		uint32_t sectionSize;
+		uint32_t viewCount;
+	};
+
+	struct RenderInstance { //Must match transform.glsl
+		glm::vec3 centre;
+		uint32_t tint;
+		uint32_t rotation[2];
+		uint32_t scaleLayer[2];
+	};
+
+	struct {
+		vko::Buffer clusterBuffer; //Bounding box of every planets.comp workgroup, owned by whichever queue last used the instances
+		vko::Buffer visibleBuffer; //Render stream indices of the reference system objects and copies that survived this frame, bucketed by level of detail then impostors
+		vko::Buffer renderBuffer; //RenderInstance per reference system object, then per copy of them for amplification, cull.comp fills in the ones it draws
+		vko::Buffer drawBuffer; //vk::DrawIndexedIndirectCommand per sphere level of detail and one for the impostor quads, once for each phase, cull.comp counts the instances
+		vko::Buffer historyBuffer; //Bit per render stream entry, set if it passed the occlusion test last frame
+		vko::Buffer statsBuffer; //Host visible CullStats from the last frame
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipelines[2]; //Draws what was visible last frame, then tests everything against the depth pyramid
+		uint32_t clusterCount = 0; //In the reference system, each copy of it is culled as that many more
+		uint32_t sectionSize = 0; //Render stream entries for every copy, and the length of each bucket's section of visible
+	} m_cull;
+
+	struct CullStats {
+		uint32_t tested; //In view and tested against the depth pyramid
+		uint32_t occluded;
+		uint32_t firstPhase;
+		uint32_t secondPhase;
+		uint32_t splatted;
+	};
+
+	struct {
+		vko::Image pyramid; //Furthest depth under each texel, level 0 is the size of the depth buffer. Rebuilt with the render targets
+		uint32_t levels = 0;
+		std::vector<vk::ImageView> levelViews;
+		vk::Sampler depthSampler;
+		vk::DescriptorSetLayout descriptorSetLayout;
+		std::vector<vk::DescriptorSet> descriptorSets; //One per level, reading the level above
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+	} m_hiz;
+
+	struct {
+		bool enabled = false; //Needs 64 bit buffer atomics
+		vko::Buffer buffer; //uint64 per pixel, depth above colour, cull.comp keeps the nearest with atomicMin
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout; //Composite pass
+		vk::Pipeline pipeline;
+	} m_splat;
+
+	struct {
+		bool enabled = false; //Needs gl_PrimitiveID in fragment shaders, which comes with the geometry shader feature
+		vko::Image image; //Render stream index and bucket above triangle under each pixel, see visibility.glsl
+		vk::RenderPass renderpass; //Clears the ids and the depth buffer for the first phase
+		vk::RenderPass renderpassLoad; //Carries on from it for the second phase
+		vk::Framebuffer framebuffer;
+		vk::PipelineLayout pipelineLayout; //The graphics set, and the bucket being drawn as a push constant
+		vk::Pipeline pipeline; //Sphere levels of detail
+		vk::Pipeline pipelineImpostors;
+		vk::DescriptorSetLayout shadeDescriptorSetLayout;
+		vk::DescriptorSet shadeDescriptorSet;
+		vk::PipelineLayout shadePipelineLayout;
+		vk::Pipeline shadePipeline; //Full screen, shades each covered pixel once
+	} m_visibility;
+
+	enum class AntiAliasing { eOff, eMsaa, eFxaa, eTaa };
+
+	struct AntiAliasingUniforms { //Must match taa.comp
+		glm::mat4 reprojection; //This frame's clip space, without the jitter, to last frame's
+		glm::vec2 jitter; //Sub-pixel offset this frame was drawn with, in pixels
+		float blend; //Weight of this frame against the history
+		uint32_t historyValid; //Cleared for the first frame after a switch, which has no history
+	};
+
+	struct {
+		AntiAliasing mode = AntiAliasing::eOff;
+		bool postSupported = false; //Post passes blit into the swapchain images, which needs transfer destination usage. Scaling the resolution down does too
+		bool outputBlit = false; //outputImage's format can be stored to and blitted from
+		vk::Filter outputFilter = vk::Filter::eNearest; //Linear if outputImage's format can be filtered
+		vko::Image outputImage; //Written by the post pass, then blitted into the swapchain image. Only while post processing
+		vko::Image historyImage; //Last temporal output, copied from outputImage
+		vko::Buffer uniformBuffer; //Host visible AntiAliasingUniforms
+		AntiAliasingUniforms uniforms;
+		glm::mat4 previousViewProjection;
+		uint32_t frame = 0; //Picks the jitter
+		vk::Sampler sampler;
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline fxaaPipeline;
+		vk::Pipeline taaPipeline;
+		double sceneTime = 0.0; //Timestamped milliseconds summed since the last report, both render passes
+		double postTime = 0.0; //The post pass and the blit after them
+		uint32_t timedFrames = 0;
+	} m_aa;
+
+	enum class GovernorKnob { eRenderScale, eLodBias, eImpostorCutoff, eAmplification, eSubsteps, eCount };
+
+	struct GovernorKnobState {
+		uint32_t level = 0; //0 is full quality, each level above is cheaper
+		uint32_t maxLevel = 0;
+		float pin = -1.0f; //Value an operator held it at from the command line, negative leaves it to the governor
+	};
+
+	struct {
+		float budget = -1.0f; //Milliseconds, FRAME_BUDGET_MS unless set from the command line. 0 switches the governor off
+		GovernorKnobState knobs[static_cast<size_t>(GovernorKnob::eCount)];
+		float lodPixelSize = 0.0f; //Where the knobs are at, pushed to cull.comp
+		float impostorPixelSize = 0.0f;
+		uint32_t copies = 1; //Render instances drawn per simulated test particle
+		uint32_t substeps = 1; //Compute dispatches each frame's time is split over
+		double frameTime = 0.0; //Milliseconds summed over the current window
+		double gpuTime = 0.0; //Both render passes and the post pass, summed the same way
+		uint32_t frames = 0;
+		uint32_t quietWindows = 0; //Windows in a row with room to spare
+		bool settling = false; //Set after a change, the window it landed in holds the rebuild and is thrown away
+	} m_governor;
+
+	struct OrbitPush {
+		uint32_t trackedCount;
+		int32_t scale;
+		float tolerance;
+		uint32_t maxSegments;
+	};
+
+	struct {
+		vko::Buffer trackedBuffer; //Instance indices of the bodies with an orbit drawn
+		vko::Buffer vertexBuffer; //Line list written by orbit.comp, ORBIT_MAX_SEGMENTS segments reserved per tracked body
+		vko::Buffer drawBuffer; //vk::DrawIndirectCommand, orbit.comp adds each orbit's vertices to its count
+		uint32_t trackedCount = 0;
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+	} m_orbits;
+
+	struct PreviewControl {
+		uint32_t generation;
+		uint32_t selectionCount;
+		uint32_t steps;
+		uint32_t stepsPerFrame;
+		uint32_t stride;
+		int32_t scale;
+		float stepTime;
+		uint32_t perturberCount;
 	};
 
 	struct {
-		vko::Buffer m_bufferVertexOrbit;
-		std::vector<int> vertices;
-		std::vector<int> offsets;
-	} m_orbitVertexInfo;
+		bool enabled = false;
+		std::vector<uint32_t> selection; //Reference system bodies to preview, the first tracked orbits if empty
+		std::vector<uint32_t> perturbers; //Reference system bodies whose pull is added to the selection's
+		uint32_t generation = 1; //Bumped to make preview.comp drop what it has built
+		vko::Buffer controlBuffer; //Host visible, PreviewControl followed by the selection and the perturbers
+		vko::Buffer stateBuffer; //Cloned bodies carried between frames while a preview is built
+		vko::Buffer vertexBuffer; //Line list, two halves of PREVIEW_MAX_SELECTION paths
+		vko::Buffer drawBuffer; //vk::DrawIndirectCommand for the last finished half
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+	} m_preview;
+
+	struct Aggregate { //Must match aggregate.glsl
+		uint32_t first; //Instance buffer index of the first member
+		uint32_t count;
+		float inner;
+		float outer;
+		glm::vec4 colour; //rgb Average member tint, w texture layer
+		glm::vec4 centre; //xyz Where the body the members orbit is, w how far they have faded into the annulus. Written by aggregate.comp
+		glm::vec4 tilt; //Orbital tilt every member shares
+		float memberSize; //Largest member scale, the fade is judged by it
+		float memberArea; //Average member cross section
+		uint32_t pad[2];
+	};
+
+	struct AggregatePush {
+		uint32_t aggregateCount;
+		float viewportHeight;
+		float fadePixelSize;
+		uint32_t copies;
+	};
+
+	struct {
+		std::vector<Aggregate> populations; //Rings and belts of the reference system big enough to be worth it, only text scenarios describe them
+		uint32_t maxCount = 0; //Most members in one, sizes the binning dispatch
+		uint32_t frame = 0; //Rebins every AGGREGATE_REBIN_INTERVAL frames
+		vko::Buffer buffer; //Aggregate per population, read by cull.comp even when there are none
+		vko::Buffer densityBuffer; //Members in each radial and angular bin of every population
+		vko::Buffer controlBuffer; //Host visible, non zero on the frames the bins are counted again
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorSet descriptorSet;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipelines[2]; //Places and fades, then bins the members
+		vk::Pipeline drawPipeline; //The annulus, drawn after the splats
+	} m_aggregate;
 
 	vko::Buffer m_bufferVertex;
 	vko::Buffer m_bufferIndex;
 	vko::Buffer m_bufferInstance;
 	vko::Image m_textureArrayPlanets;
-	vko::Image m_textureStarfield;
+	vko::Image m_textureStarfield; //Cubemap, converted from the equirectangular image by PrepareSky
 	vk::QueryPool m_queryPool;
 	std::vector<uint64_t> m_queryResults;
 	
-	void CreateCommandBuffers();
+	vk::CommandBuffer RecordFrame(uint32_t imageIndex);
+	void RecordFrameStart(vk::CommandBuffer cmdBuffer);
+	void DispatchCull(vk::CommandBuffer cmdBuffer, uint32_t phase);
+	void RecordSecondCull(vk::CommandBuffer cmdBuffer);
+	void ShadeVisibility(vk::CommandBuffer cmdBuffer);
+	void RecordFrameEnd(vk::CommandBuffer cmdBuffer, vk::Image swapchainImage);
+	void DrawSky(vk::CommandBuffer cmdBuffer);
+	void DrawCulledObjects(vk::CommandBuffer cmdBuffer, uint32_t phase);
+	void BuildOcclusionPyramid(vk::CommandBuffer cmdBuffer);
 	void CreateDescriptorPool();
 	void CreateDescriptorSetLayout();
 	void CreateDescriptorSet();
@@ -122,16 +442,50 @@ private:
 	void RenderFrame();
 
 	void PrepareInstance();
+	void PrepareSky();
 	void UpdateCameraUniformBuffer();
+	void UpdateViews();
 	void UpdateComputeUniformBuffer();
 	void PrepareCompute();
 	void CreateComputeCommandBuffer();
+	void ReadEnsembleDiagnostics();
+	void PollCheckpoint();
+	void PollRecording();
+	bool IsComputeSubmitComplete(uint64_t submitIndex);
+	void PrepareTimeline();
+	void PollTimeline();
+	void PrepareSplats();
+	void PrepareOcclusion();
+	void PrepareVisibility();
+	void CreateVisibilityTargets();
+	void CreateSplatPipeline();
+	void CreateOcclusionTargets();
+	vk::Pipeline CreateFullScreenPipeline(const std::string& fragShaderPath, vk::PipelineLayout layout, bool depthTest);
+	void PrepareAntiAliasing();
+	void CreateAntiAliasingTargets();
+	void DestroyRenderTargetResources();
+	bool IsAntiAliasingSupported(AntiAliasing mode);
+	void SetAntiAliasing(AntiAliasing mode);
+	void RebuildRenderTargets();
+	void UpdateAntiAliasing();
+	void PostProcess(vk::CommandBuffer cmdBuffer, vk::Image swapchainImage);
+	void ReportAntiAliasingCost();
+	std::string GetAntiAliasingName(AntiAliasing mode);
+	void PrepareGovernor();
+	void UpdateGovernor(double gpuTime);
+	void SetGovernorLevel(GovernorKnob knob, uint32_t level);
+	void UpdateGovernorValues();
+	void ReportGovernor();
+	std::string GetGovernorKnobName(GovernorKnob knob);
+	void PrepareCulling();
+	void PrepareOrbits();
+	void PreparePreview();
+	void UpdatePreviewControl();
+	void PrepareAggregates();
+	void CreateAggregatePipeline();
+	void UpdateAggregateControl();
 
-	std::vector<glm::vec2> CalculateOrbitPoints(glm::vec4 pos, glm::vec4 vel, double G, float timestep);
-
-	float RandomRange(float min, float max) { return min + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (max - min))); }
-
-	double GetTimeQueryResult(uint32_t timeStampValidBits);
+	double GetTimeQueryResult(uint32_t timeStampValidBits, uint32_t firstQuery = 0);
 
 };
 	void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
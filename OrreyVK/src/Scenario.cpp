@@ -0,0 +1,324 @@
+#include "Scenario.h"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace sim {
+
+	uint64_t Scenario::GetObjectCount() const
+	{
+		uint64_t count = bodies.size();
+		for (const ScenarioPopulation& population : populations)
+			count += population.count;
+		return count;
+	}
+
+	namespace {
+		int32_t FindBody(const Scenario& scenario, const std::string& name)
+		{
+			for (size_t i = 0; i < scenario.bodies.size(); i++)
+				if (scenario.bodies[i].name == name)
+					return static_cast<int32_t>(i);
+			return -1;
+		}
+
+		float DegToRad(float deg) { return deg * M_PI / 180.0; }
+		float InitialVelocity(float r) { return r > 0.0f ? sqrt(G / r) : 0.0f; }
+	}
+
+	bool LoadScenario(const std::string& path, Scenario& scenario)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			spdlog::error("Scenario: Could not open {}", path);
+			return false;
+		}
+
+		scenario = Scenario();
+		scenario.path = path;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			line = line.substr(0, line.find('#'));
+			std::istringstream tokens(line);
+			std::string type, name;
+			if (!(tokens >> type))
+				continue;
+			if (!(tokens >> name))
+			{
+				spdlog::error("Scenario: {}:{} {} needs a name", path, lineNumber, type);
+				return false;
+			}
+
+			//Everything after the name is key value pairs
+			ScenarioBody body;
+			ScenarioPopulation population;
+			body.name = population.name = name;
+			std::string key;
+			bool valid = true;
+			while (valid && tokens >> key)
+			{
+				if (key == "parent")
+				{
+					std::string parentName;
+					tokens >> parentName;
+					body.parent = population.parent = FindBody(scenario, parentName);
+					if (body.parent < 0)
+					{
+						spdlog::error("Scenario: {}:{} parent {} has to be defined before {}", path, lineNumber, parentName, name);
+						return false;
+					}
+				}
+				else if (key == "texture")
+				{
+					valid = static_cast<bool>(tokens >> body.texture);
+					population.texture = body.texture;
+				}
+				else if (key == "mass")
+				{
+					valid = static_cast<bool>(tokens >> body.mass);
+					population.mass = body.mass;
+				}
+				else if (type == "body" && key == "distance")
+					valid = static_cast<bool>(tokens >> body.distance);
+				else if (type == "body" && key == "scale")
+					valid = static_cast<bool>(tokens >> body.scale);
+				else if (type == "body" && key == "tilt")
+					valid = static_cast<bool>(tokens >> body.tilt);
+				else if (type == "body" && key == "spin")
+					valid = static_cast<bool>(tokens >> body.spin);
+				else if (type == "body" && key == "inclination")
+					valid = static_cast<bool>(tokens >> body.inclination);
+				else if (type == "body" && key == "tint")
+					valid = static_cast<bool>(tokens >> body.tint.r >> body.tint.g >> body.tint.b);
+				else if (type == "population" && key == "count")
+					valid = static_cast<bool>(tokens >> population.count);
+				else if (type == "population" && key == "inner")
+					valid = static_cast<bool>(tokens >> population.inner);
+				else if (type == "population" && key == "outer")
+					valid = static_cast<bool>(tokens >> population.outer);
+				else if (type == "population" && key == "thickness")
+					valid = static_cast<bool>(tokens >> population.thickness);
+				else if (type == "population" && key == "seed")
+					valid = static_cast<bool>(tokens >> population.seed);
+				else if (type == "population" && key == "scale")
+					valid = static_cast<bool>(tokens >> population.scale.x >> population.scale.y);
+				else if (type == "population" && key == "brightness")
+					valid = static_cast<bool>(tokens >> population.brightness.x >> population.brightness.y);
+				else if (type == "population" && key == "clockwise")
+					population.clockwise = true;
+				else if (type == "population" && key == "anticlockwise")
+					population.clockwise = false;
+				else
+					valid = false;
+			}
+
+			if (!valid)
+			{
+				spdlog::error("Scenario: {}:{} could not read {} of {} {}", path, lineNumber, key, type, name);
+				return false;
+			}
+
+			if (type == "body")
+				scenario.bodies.push_back(body);
+			else if (type == "population")
+			{
+				if (population.outer < population.inner)
+				{
+					spdlog::error("Scenario: {}:{} population {} has its outer radius inside its inner one", path, lineNumber, name);
+					return false;
+				}
+				//Members are indexed with 32 bit integers on the GPU
+				if (population.count > UINT32_MAX)
+				{
+					spdlog::error("Scenario: {}:{} population {} has {} members, at most {} fit", path, lineNumber, name, population.count, UINT32_MAX);
+					return false;
+				}
+				scenario.populations.push_back(population);
+			}
+			else
+			{
+				spdlog::error("Scenario: {}:{} unknown type {}", path, lineNumber, type);
+				return false;
+			}
+		}
+
+		if (scenario.bodies.empty())
+		{
+			spdlog::error("Scenario: {} has no bodies, the first one is the sun", path);
+			return false;
+		}
+		if (scenario.GetObjectCount() > UINT32_MAX)
+		{
+			spdlog::error("Scenario: {} has {} objects, at most {} fit", path, scenario.GetObjectCount(), UINT32_MAX);
+			return false;
+		}
+		return true;
+	}
+
+	glm::uvec4 Philox(glm::uvec4 counter, glm::uvec2 key)
+	{
+		for (int round = 0; round < 10; round++)
+		{
+			uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter.x;
+			uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter.z;
+			counter = glm::uvec4(static_cast<uint32_t>(product1 >> 32) ^ counter.y ^ key.x, static_cast<uint32_t>(product1),
+				static_cast<uint32_t>(product0 >> 32) ^ counter.w ^ key.y, static_cast<uint32_t>(product0));
+			key += glm::uvec2(0x9E3779B9u, 0xBB67AE85u);
+		}
+		return counter;
+	}
+
+	namespace {
+		//Top 24 bits so every value is exactly representable, [0, 1)
+		glm::vec4 ToUniform(glm::uvec4 bits) { return glm::vec4(bits >> glm::uvec4(8)) * (1.0f / 16777216.0f); }
+
+		//Box-Muller, two normally distributed values from two uniform ones
+		glm::vec2 ToNormal(glm::vec2 uniform)
+		{
+			float radius = sqrt(-2.0f * log(1.0f - uniform.x));
+			float angle = 2.0f * M_PI * uniform.y;
+			return glm::vec2(radius * cos(angle), radius * sin(angle));
+		}
+	}
+
+	void GenerateBodies(const Scenario& scenario, int32_t scale, uint32_t system, float perturbation, CelestialObj* bodies)
+	{
+		//Built in a local copy first as moons take their parent's position, and the destination may be write combined memory
+		std::vector<CelestialObj> objects(scenario.bodies.size());
+		for (size_t i = 0; i < scenario.bodies.size(); i++)
+		{
+			const ScenarioBody& body = scenario.bodies[i];
+			CelestialObj& obj = objects[i];
+			obj.position = glm::vec4(body.distance * scale, 0.0f, 0.0f, body.mass);
+			obj.velocity = glm::vec4(0.0f, 0.0f, InitialVelocity(body.distance), static_cast<float>(system));
+			obj.scale = glm::vec4(body.scale, body.scale, body.scale, body.texture);
+			obj.rotation = glm::vec4(DegToRad(body.tilt), 0.0f, 0.0f, 0.0f);
+			obj.rotationSpeed = glm::vec4(0.0f, DegToRad(body.spin), 0.0f, 0.0f);
+			if (body.parent >= 0)
+				obj.posOffset = glm::vec4(glm::vec3(objects[body.parent].position), static_cast<float>(body.parent));
+			obj.orbitalTilt = glm::vec4(DegToRad(body.inclination), 0.0f, 0.0f, 0.0f);
+			obj.colourTint = body.tint;
+			if (system > 0)
+			{
+				glm::vec2 noise = ToNormal(glm::vec2(ToUniform(Philox(glm::uvec4(i, 0, system, 1), glm::uvec2(0)))));
+				obj.velocity.x *= 1.0f + noise.x * perturbation;
+				obj.velocity.z *= 1.0f + noise.y * perturbation;
+			}
+		}
+		std::copy(objects.begin(), objects.end(), bodies);
+	}
+
+	std::vector<PopulationParams> GetPopulationParams(const Scenario& scenario, const CelestialObj* bodies, int32_t scale, uint32_t system, float perturbation, uint32_t systemOffset)
+	{
+		std::vector<PopulationParams> params;
+		uint32_t offset = systemOffset + static_cast<uint32_t>(scenario.bodies.size());
+		for (const ScenarioPopulation& population : scenario.populations)
+		{
+			PopulationParams populationParams = {};
+			if (population.parent >= 0)
+			{
+				populationParams.parentPosition = glm::vec4(glm::vec3(bodies[population.parent].position), static_cast<float>(population.parent));
+				populationParams.parentRotation = bodies[population.parent].rotation;
+			}
+			populationParams.radii = glm::vec4(population.inner * scale, population.outer * scale, population.thickness * scale, population.mass);
+			populationParams.appearance = glm::vec4(population.scale, population.brightness);
+			populationParams.offset = offset;
+			populationParams.count = static_cast<uint32_t>(population.count);
+			populationParams.seed = population.seed;
+			populationParams.system = system;
+			populationParams.texture = population.texture;
+			populationParams.perturbation = perturbation;
+			populationParams.clockwise = population.clockwise ? 1 : 0;
+			populationParams.scale = scale;
+			params.push_back(populationParams);
+			offset += populationParams.count;
+		}
+		return params;
+	}
+
+	CelestialObj GeneratePopulationObject(const PopulationParams& params, uint32_t index)
+	{
+		glm::uvec2 key = glm::uvec2(params.seed, 0);
+		glm::vec4 placement = ToUniform(Philox(glm::uvec4(index, 0, params.system, 0), key));
+		glm::vec4 size = ToUniform(Philox(glm::uvec4(index, 1, params.system, 0), key));
+		glm::vec4 spin = ToUniform(Philox(glm::uvec4(index, 2, params.system, 0), key));
+		glm::vec4 extra = ToUniform(Philox(glm::uvec4(index, 3, params.system, 0), key));
+
+		//Uniform over the annulus area
+		CelestialObj obj;
+		float inner = params.radii.x;
+		float outer = params.radii.y;
+		float rho = sqrt((outer * outer - inner * inner) * placement.x + inner * inner);
+		float theta = 2.0f * M_PI * (index + placement.y) / params.count; //Stratified to match populate.comp
+		float height = (placement.z - 0.5f) * params.radii.z;
+		obj.position = glm::vec4(rho * cos(theta), height, rho * sin(theta), params.radii.w);
+
+		float vel = InitialVelocity(rho / params.scale); //Velocity calculation needs to be in unscaled AU
+		glm::vec2 normalisedPos = glm::vec2(cos(theta), sin(theta));
+		if (params.clockwise)
+			obj.velocity = glm::vec4(normalisedPos.y * vel, 0.0f, -normalisedPos.x * vel, static_cast<float>(params.system));
+		else
+			obj.velocity = glm::vec4(-normalisedPos.y * vel, 0.0f, normalisedPos.x * vel, static_cast<float>(params.system));
+		if (params.system > 0)
+		{
+			glm::vec2 noise = ToNormal(glm::vec2(extra.z, extra.w));
+			obj.velocity.x *= 1.0f + noise.x * params.perturbation;
+			obj.velocity.z *= 1.0f + noise.y * params.perturbation;
+		}
+
+		float scaleRange = params.appearance.y - params.appearance.x;
+		obj.scale = glm::vec4(glm::vec3(params.appearance.x) + scaleRange * glm::vec3(size), params.texture);
+		obj.rotation = glm::vec4(M_PI * spin.x, M_PI * spin.y, M_PI * spin.z, 0.0f);
+		obj.rotationSpeed = glm::vec4(spin.w, extra.x, extra.y, 0.0f);
+		obj.posOffset = params.parentPosition;
+		obj.orbitalTilt = params.parentPosition.w != 0.0f ? params.parentRotation : glm::vec4(0.0f);
+		float brightness = params.appearance.z + (params.appearance.w - params.appearance.z) * placement.w;
+		obj.colourTint = glm::vec4(brightness, brightness, brightness, 1.0f);
+		return obj;
+	}
+
+	void GenerateScenario(const Scenario& scenario, int32_t scale, uint32_t system, float perturbation, CelestialObj* objects)
+	{
+		GenerateBodies(scenario, scale, system, perturbation, objects);
+		std::vector<PopulationParams> populations = GetPopulationParams(scenario, objects, scale, system, perturbation, 0);
+		for (const PopulationParams& params : populations)
+		{
+			ParallelFor(params.count, SCENARIO_CHUNK_SIZE, [&](uint64_t begin, uint64_t end)
+			{
+				for (uint64_t i = begin; i < end; i++)
+					objects[params.offset + i] = GeneratePopulationObject(params, static_cast<uint32_t>(i));
+			});
+		}
+	}
+
+	void ParallelFor(uint64_t count, uint64_t chunkSize, const std::function<void(uint64_t, uint64_t)>& task)
+	{
+		uint64_t chunkCount = (count + chunkSize - 1) / chunkSize;
+		uint32_t threadCount = static_cast<uint32_t>(std::min<uint64_t>(std::max(1u, std::thread::hardware_concurrency()), chunkCount));
+		std::atomic<uint64_t> nextChunk(0);
+
+		auto worker = [&]()
+		{
+			for (uint64_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+				task(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+		};
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; i++)
+			threads.emplace_back(worker);
+		if (chunkCount > 0)
+			worker();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "Simulation.h"
+
+namespace sim {
+	const uint64_t SCENARIO_CHUNK_SIZE = 16384; //Objects per generation task
+
+	//An explicitly placed object, distances in AU and angles in degrees
+	struct ScenarioBody {
+		std::string name;
+		int32_t parent = -1; //Index of the body this one orbits, -1 for the sun
+		float distance = 0.0f;
+		float mass = 0.0f;
+		float scale = 1.0f;
+		float texture = 0.0f;
+		float tilt = 0.0f;
+		float spin = 0.0f; //Degrees per day
+		float inclination = 0.0f; //Tilt of the orbital plane
+		glm::vec4 tint = glm::vec4(1.0f);
+	};
+
+	//A procedural ring or belt of test particles
+	struct ScenarioPopulation {
+		std::string name;
+		int32_t parent = -1;
+		uint64_t count = 0;
+		float inner = 0.0f;
+		float outer = 0.0f;
+		float thickness = 0.5f / 30.0f;
+		uint32_t seed = 0;
+		bool clockwise = false;
+		float mass = 3.69432e-32f;
+		float texture = 1.0f;
+		glm::vec2 scale = glm::vec2(0.01f, 0.07f);
+		glm::vec2 brightness = glm::vec2(0.4f, 0.9f);
+	};
+
+	//One population of one system as populate.comp takes it in push constants
+	struct PopulationParams {
+		glm::vec4 parentPosition; //xyz Position of the parent body, w its index, 0 for the sun
+		glm::vec4 parentRotation; //Becomes the orbital tilt of each member
+		glm::vec4 radii; //x Inner, y Outer, z Thickness, all scaled, w Mass
+		glm::vec4 appearance; //xy Scale range, zw Brightness range
+		uint32_t offset; //Instance buffer index of the first member
+		uint32_t count;
+		uint32_t seed;
+		uint32_t system;
+		float texture;
+		float perturbation;
+		uint32_t clockwise;
+		int32_t scale;
+	};
+
+	struct Scenario {
+		std::string path;
+		std::vector<ScenarioBody> bodies;
+		std::vector<ScenarioPopulation> populations;
+
+		uint64_t GetObjectCount() const;
+	};
+
+	//Text scenarios, see resources/scenarios/solar_system.txt for the format
+	bool LoadScenario(const std::string& path, Scenario& scenario);
+
+	//Writes the explicit bodies of one system, copies with a system index above 0 get their velocities perturbed
+	void GenerateBodies(const Scenario& scenario, int32_t scale, uint32_t system, float perturbation, CelestialObj* bodies);
+	//Populations of one system whose bodies start at systemOffset, members follow the bodies in file order
+	std::vector<PopulationParams> GetPopulationParams(const Scenario& scenario, const CelestialObj* bodies, int32_t scale, uint32_t system, float perturbation, uint32_t systemOffset);
+	//Member index of a population, populate.comp does the same on the GPU
+	CelestialObj GeneratePopulationObject(const PopulationParams& params, uint32_t index);
+	//Writes one whole system of GetObjectCount() objects on the CPU
+	void GenerateScenario(const Scenario& scenario, int32_t scale, uint32_t system, float perturbation, CelestialObj* objects);
+
+	//Philox4x32-10, a counter based RNG so any object's numbers can be drawn without generating the ones before it
+	glm::uvec4 Philox(glm::uvec4 counter, glm::uvec2 key);
+
+	//Runs task(begin, end) over count items in chunks spread across every hardware thread
+	void ParallelFor(uint64_t count, uint64_t chunkSize, const std::function<void(uint64_t, uint64_t)>& task);
+}
+#endif
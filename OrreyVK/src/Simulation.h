@@ -0,0 +1,33 @@
+#pragma once
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cstdint>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+struct CelestialObj {
+	glm::vec4 position; //xyz Position, w Mass, negative for the padding that rounds ensemble systems up to whole workgroups
+	glm::vec4 velocity; //xyz Velocity w Index of the ensemble system the object belongs to
+	glm::vec4 scale;	//xyz Scale w texIndex
+	glm::vec4 rotation; //xyz Current rotation on each axis
+	glm::vec4 rotationSpeed; //xyz Rotation speed for each axis
+	glm::vec4 posOffset; //If w != 0 then object is a moon and this describes the position of the object it is orbiting
+	glm::vec4 orbitalTilt; //xyz Angle of tilt for the orbital plane
+	glm::vec4 colourTint = glm::vec4(1.0);
+};
+
+namespace sim {
+	//Converted G constant for AU/SM, T: 1s ~= 1 earth sidereal day
+	const double G = 0.0002959122083;
+
+	//Mirrors the compute uniform buffer used by planets.comp
+	struct StepParams {
+		float deltaT = 0.0f;
+		float speed = 1.0f;
+		int32_t scale = 1;
+		uint32_t systemSize = 0;
+	};
+}
+#endif
@@ -1,23 +1,180 @@
 #include "SolidSphere.h"
 
+#include <map>
+#include <array>
+#include <deque>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	const size_t OPTIMISE_CACHE_SIZE = 32; //LRU cache the triangle order is scored against
+	const size_t ACMR_CACHE_SIZE = 16; //FIFO cache the miss ratio is reported against
+
+	//Linear-speed vertex cache optimisation (Forsyth). Vertices recently used, or with few triangles left, score highest
+	float VertexScore(int cachePosition, uint32_t remaining)
+	{
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			//The last triangle's vertices score the same so no order is favoured within it
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = powf(1.0f - float(cachePosition - 3) / float(OPTIMISE_CACHE_SIZE - 3), 1.5f);
+		}
+		return score + 2.0f / sqrtf(float(remaining));
+	}
+
+	std::vector<uint16_t> OptimiseVertexCache(const std::vector<uint16_t>& triangles, size_t vertexCount)
+	{
+		size_t triangleCount = triangles.size() / 3;
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (uint16_t vertex : triangles)
+			remaining[vertex]++;
+
+		std::vector<float> scores(vertexCount);
+		for (size_t vertex = 0; vertex < vertexCount; vertex++)
+			scores[vertex] = VertexScore(-1, remaining[vertex]);
+
+		std::vector<bool> added(triangleCount, false);
+		std::vector<uint16_t> cache; //Most recent first
+		std::vector<uint16_t> result;
+		result.reserve(triangles.size());
+
+		for (size_t step = 0; step < triangleCount; step++)
+		{
+			//The meshes are a few hundred triangles, every one left is scanned
+			size_t best = 0;
+			float bestScore = -1.0f;
+			for (size_t triangle = 0; triangle < triangleCount; triangle++)
+			{
+				if (added[triangle])
+					continue;
+				float score = scores[triangles[triangle * 3]] + scores[triangles[triangle * 3 + 1]] + scores[triangles[triangle * 3 + 2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = triangle;
+				}
+			}
+
+			added[best] = true;
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				uint16_t vertex = triangles[best * 3 + corner];
+				result.push_back(vertex);
+				remaining[vertex]--;
+				cache.erase(std::remove(cache.begin(), cache.end(), vertex), cache.end());
+				cache.insert(cache.begin(), vertex);
+			}
+
+			for (size_t i = OPTIMISE_CACHE_SIZE; i < cache.size(); i++)
+				scores[cache[i]] = VertexScore(-1, remaining[cache[i]]);
+			if (cache.size() > OPTIMISE_CACHE_SIZE)
+				cache.resize(OPTIMISE_CACHE_SIZE);
+			for (size_t i = 0; i < cache.size(); i++)
+				scores[cache[i]] = VertexScore(int(i), remaining[cache[i]]);
+		}
+
+		return result;
+	}
+
+	float AverageCacheMissRatio(const std::vector<uint16_t>& triangles)
+	{
+		if (triangles.empty())
+			return 0.0f;
+
+		std::deque<uint16_t> cache;
+		size_t misses = 0;
+		for (uint16_t vertex : triangles)
+		{
+			if (std::find(cache.begin(), cache.end(), vertex) == cache.end())
+			{
+				misses++;
+				cache.push_back(vertex);
+				if (cache.size() > ACMR_CACHE_SIZE)
+					cache.pop_front();
+			}
+		}
+		return float(misses) / float(triangles.size() / 3);
+	}
+
+	//The texture coordinates SolidSphere has always used, u runs backwards around y from +x and v from the south pole
+	glm::vec2 SphereUV(glm::vec3 pos)
+	{
+		float theta = atan2f(pos.z, pos.x);
+		if (theta < 0.0f)
+			theta += float(M_PI * 2);
+		float phi = acosf(std::max(-1.0f, std::min(1.0f, pos.y / glm::length(pos))));
+		return glm::vec2(1.0f - theta / float(M_PI * 2), 1.0f - phi / float(M_PI));
+	}
+}
+
 SolidSphere::SolidSphere()
 {
 
 }
 
-SolidSphere::SolidSphere(float radius, size_t stacks, size_t slices)		//Create the planet spheare with normals.
+SolidSphere::SolidSphere(float radius, size_t stacks, size_t slices, size_t lodCount)		//Create the planet spheare with normals.
+{
+	//Each level halves the resolution of the one before, the last is always an octahedron
+	for (size_t lod = 0; lod < lodCount; lod++)
+	{
+		if (lod > 0 && lod == lodCount - 1)
+		{
+			stacks = 2;
+			slices = 4;
+		}
+		AddLod(radius, stacks, slices);
+		stacks = std::max<size_t>(stacks / 2, 2);
+		slices = std::max<size_t>(slices / 2, 4);
+	}
+}
+
+SolidSphere SolidSphere::Icosphere(float radius, size_t frequency, size_t lodCount)
+{
+	//Each level halves the frequency of the one before, rounding up, the last is always an icosahedron
+	SolidSphere sphere;
+	for (size_t lod = 0; lod < lodCount; lod++)
+	{
+		size_t lodFrequency = (frequency + (size_t(1) << lod) - 1) >> lod;
+		if (lod > 0 && lod == lodCount - 1)
+			lodFrequency = 1;
+		sphere.AddIcosphereLod(radius, std::max<size_t>(lodFrequency, 1));
+	}
+	return sphere;
+}
+
+void SolidSphere::AddVertex(glm::vec3 pos, glm::vec2 uv)
+{
+	VulkanTools::VertexInput vertex;
+	for (int i = 0; i < 3; i++)
+		vertex.pos[i] = static_cast<int16_t>(glm::packSnorm1x16(pos[i]));
+	vertex.pos[3] = 0;
+	vertex.uv[0] = glm::packHalf1x16(uv.x);
+	vertex.uv[1] = glm::packHalf1x16(uv.y);
+	vertices.push_back(vertex);
+}
+
+void SolidSphere::AddLod(float radius, size_t stacks, size_t slices)
 {
 	// Adapated from: https://github.com/Erkaman/cute-deferred-shading/blob/master/src/main.cpp#L573
 
-	float lengthInv = 1.0 / radius;
+	Lod lod;
+	lod.firstIndex = indices.size();
+	lod.vertexOffset = vertices.size();
+
 	// loop through stacks.
-	for (int i = 0; i <= stacks; ++i) {
+	for (size_t i = 0; i <= stacks; ++i) {
 
 		float V = (float)i / (float)stacks;
 		float phi = V * M_PI;
 
 		// loop through the slices.
-		for (int j = 0; j <= slices; ++j) {
+		for (size_t j = 0; j <= slices; ++j) {
 
 			float U = (float)j / (float)slices;
 			float theta = U * (M_PI * 2);
@@ -27,20 +184,185 @@ SolidSphere::SolidSphere(float radius, size_t stacks, size_t slices)		//Create t
 			float y = cos(phi) * radius;
 			float z = sin(theta) * sin(phi) * radius;
 
-			vertices.push_back({ { x, y, z }, { x, y, z, 1.0 }, {1.0 - ((float)j / slices), 1.0 - ((float)i / stacks), 0.0} });
+			AddVertex({ x, y, z }, { 1.0 - ((float)j / slices), 1.0 - ((float)i / stacks) });
+		}
+	}
+
+	// Calc The Index Positions, two triangles per quad. Indices are relative to the level's first vertex
+	for (size_t i = 0; i < stacks; ++i) {
+		for (size_t j = 0; j < slices; ++j) {
+			uint16_t top = uint16_t(i * (slices + 1) + j);
+			uint16_t bottom = uint16_t(top + slices + 1);
+
+			indices.push_back(top);
+			indices.push_back(uint16_t(bottom + 1));
+			indices.push_back(bottom);
+
+			indices.push_back(uint16_t(bottom + 1));
+			indices.push_back(top);
+			indices.push_back(uint16_t(top + 1));
+		}
+	}
+
+	lod.indexCount = indices.size() - lod.firstIndex;
+	OptimiseLod(lod);
+	lods.push_back(lod);
+}
+
+void SolidSphere::AddIcosphereLod(float radius, size_t frequency)
+{
+	Lod lod;
+	lod.firstIndex = indices.size();
+	lod.vertexOffset = vertices.size();
+
+	const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+	const glm::vec3 corners[12] = {
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+	};
+	const uint8_t faces[20][3] = {
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+	};
+
+	//Vertices are shared wherever the position and texture coordinates both match, so only the seam and poles are split
+	std::map<std::array<uint16_t, 5>, uint16_t> lookup;
+	auto addCorner = [&](glm::vec3 pos, glm::vec2 uv) -> uint16_t {
+		AddVertex(pos, uv);
+		const VulkanTools::VertexInput& vertex = vertices.back();
+		std::array<uint16_t, 5> key = { uint16_t(vertex.pos[0]), uint16_t(vertex.pos[1]), uint16_t(vertex.pos[2]), vertex.uv[0], vertex.uv[1] };
+		auto found = lookup.find(key);
+		if (found != lookup.end())
+		{
+			vertices.pop_back();
+			return found->second;
+		}
+		uint16_t index = uint16_t(vertices.size() - 1 - lod.vertexOffset);
+		lookup[key] = index;
+		return index;
+	};
+
+	auto addTriangle = [&](glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+		glm::vec3 pos[3] = { glm::normalize(a) * radius, glm::normalize(b) * radius, glm::normalize(c) * radius };
+
+		//Same facing as the stacks and slices sphere
+		if (glm::dot(glm::cross(pos[1] - pos[0], pos[2] - pos[0]), pos[0] + pos[1] + pos[2]) < 0.0f)
+			std::swap(pos[1], pos[2]);
+
+		//Triangles across the seam take u past 1 rather than interpolating back across the whole texture
+		glm::vec2 uv[3];
+		bool pole[3];
+		float minU = 2.0f;
+		float maxU = -1.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			uv[i] = SphereUV(pos[i]);
+			pole[i] = glm::length(glm::vec2(pos[i].x, pos[i].z)) < radius * 1e-4f;
+			if (!pole[i])
+			{
+				minU = std::min(minU, uv[i].x);
+				maxU = std::max(maxU, uv[i].x);
+			}
+		}
+		float poleU = 0.0f;
+		int poleCount = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			if (pole[i])
+			{
+				poleCount++;
+				continue;
+			}
+			if (maxU - minU > 0.5f && uv[i].x < 0.5f)
+				uv[i].x += 1.0f;
+			poleU += uv[i].x;
+		}
+
+		//Poles have no longitude, each triangle gives its own the middle of the other two
+		for (int i = 0; i < 3; i++)
+		{
+			if (pole[i])
+				uv[i].x = poleU / float(3 - poleCount);
+			indices.push_back(addCorner(pos[i], uv[i]));
+		}
+	};
+
+	//Split each face into a triangular grid, frequency steps along each edge
+	float step = 1.0f / float(frequency);
+	for (const auto& face : faces)
+	{
+		glm::vec3 a = corners[face[0]];
+		glm::vec3 ab = (corners[face[1]] - a) * step;
+		glm::vec3 ac = (corners[face[2]] - a) * step;
+		for (size_t i = 0; i < frequency; i++)
+		{
+			for (size_t j = 0; j + i < frequency; j++)
+			{
+				glm::vec3 p = a + ab * float(i) + ac * float(j);
+				addTriangle(p, p + ab, p + ac);
+				if (i + j + 1 < frequency)
+					addTriangle(p + ab, p + ab + ac, p + ac);
+			}
 		}
 	}
 
-	// Calc The Index Positions
-	for (int i = 0; i < slices * stacks + slices; ++i) {
-		indices.push_back(uint16_t(i));
-		indices.push_back(uint16_t(i + slices + 1));
-		indices.push_back(uint16_t(i + slices));
+	lod.indexCount = indices.size() - lod.firstIndex;
+	OptimiseLod(lod);
+	lods.push_back(lod);
+}
+
+void SolidSphere::OptimiseLod(Lod& lod)		//Reorder a freshly added level for the post transform cache, then its vertices for fetch
+{
+	size_t vertexCount = vertices.size() - lod.vertexOffset;
+	std::vector<uint16_t> triangles(indices.begin() + lod.firstIndex, indices.end());
+
+	CacheStats stats;
+	stats.acmrBefore = AverageCacheMissRatio(triangles);
+	triangles = OptimiseVertexCache(triangles, vertexCount);
+
+	//Vertices in the order they are first used, so the fetches walk forwards through memory
+	std::vector<int32_t> remap(vertexCount, -1);
+	uint16_t next = 0;
+	for (uint16_t& vertex : triangles)
+	{
+		if (remap[vertex] < 0)
+			remap[vertex] = next++;
+		vertex = uint16_t(remap[vertex]);
+	}
+
+	std::vector<VulkanTools::VertexInput> reordered(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (remap[vertex] < 0)
+			remap[vertex] = next++;
+		reordered[remap[vertex]] = vertices[lod.vertexOffset + vertex];
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices.begin() + lod.vertexOffset);
+	std::copy(triangles.begin(), triangles.end(), indices.begin() + lod.firstIndex);
+
+	//The mesh is convex and drawn with back faces culled, so it never overdraws itself and the cache order is all that matters
+	stats.acmrAfter = AverageCacheMissRatio(triangles);
+	stats.vertexCount = uint32_t(vertexCount);
+	cacheStats.push_back(stats);
+}
+
+void SolidSphere::AddImpostorQuad()		//Camera facing quad the sphere is ray cast onto, corners at -1 and 1
+{
+	impostorQuad.firstIndex = indices.size();
+	impostorQuad.vertexOffset = vertices.size();
+
+	for (int i = 0; i < 4; ++i) {
+		float x = (i & 1) ? 1.0 : -1.0;
+		float y = (i & 2) ? 1.0 : -1.0;
+		AddVertex({ x, y, 0.0 }, { 0.5 + x * 0.5, 0.5 + y * 0.5 });
+	}
 
-		indices.push_back(uint16_t(i + slices + 1));
-		indices.push_back(uint16_t(i));
-		indices.push_back(uint16_t(i + 1));
-	}	
+	uint16_t quadIndices[] = { 0, 1, 2, 2, 1, 3 };
+	indices.insert(indices.end(), quadIndices, quadIndices + 6);
+	impostorQuad.indexCount = 6;
 }
 
 SolidSphere::~SolidSphere()
@@ -56,8 +378,7 @@ vk::VertexInputBindingDescription SolidSphere::GetVertexBindingDescription()
 std::vector<vk::VertexInputAttributeDescription> SolidSphere::GetVertexAttributeDescription()
 {
 	return std::vector<vk::VertexInputAttributeDescription>{
-						vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(VulkanTools::VertexInput, pos)),
-						vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(VulkanTools::VertexInput, colour)),
-						vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32B32Sfloat, offsetof(VulkanTools::VertexInput, uv))
+						vk::VertexInputAttributeDescription(0, 0, vk::Format::eR16G16B16A16Snorm, offsetof(VulkanTools::VertexInput, pos)),
+						vk::VertexInputAttributeDescription(2, 0, vk::Format::eR16G16Sfloat, offsetof(VulkanTools::VertexInput, uv))
 	};
 }
@@ -5,25 +5,58 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <vector>
+#include <algorithm>
 #include <vulkan/vulkan.hpp>
 #include "Types.h"
 
 class SolidSphere
 {
+public:
+	//Range of one level of detail within the shared vertex and index lists, laid out for vk::DrawIndexedIndirectCommand
+	struct Lod
+	{
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+	};
+
+	//Average cache miss ratio of a level, vertices transformed per triangle through a FIFO post transform cache
+	struct CacheStats
+	{
+		float acmrBefore;
+		float acmrAfter;
+		uint32_t vertexCount;
+	};
+
 private:
 	std::vector<VulkanTools::VertexInput> vertices;
-	std::vector<float> normals;
 	std::vector<uint16_t> indices;
+	std::vector<Lod> lods;
+	std::vector<CacheStats> cacheStats;
+	Lod impostorQuad;
+
+	void AddLod(float radius, size_t stacks, size_t slices);
+	void AddIcosphereLod(float radius, size_t frequency);
+	void AddVertex(glm::vec3 pos, glm::vec2 uv);
+	void OptimiseLod(Lod& lod);
 public:
 	SolidSphere();
-	SolidSphere(float radius, size_t stacks = 20, size_t slices = 20);
+	SolidSphere(float radius, size_t stacks = 20, size_t slices = 20, size_t lodCount = 1);
 	~SolidSphere();
 
+	//Geodesic sphere, each icosahedron face split into frequency^2 triangles. Rounder than stacks and slices for the same triangle count
+	static SolidSphere Icosphere(float radius, size_t frequency = 6, size_t lodCount = 1);
+
+	void AddImpostorQuad();
+
 	vk::VertexInputBindingDescription GetVertexBindingDescription();
 	std::vector<vk::VertexInputAttributeDescription> GetVertexAttributeDescription();
 	vk::DeviceSize GetVerticesSize() { return sizeof(vertices[0]) * vertices.size(); }
 	vk::DeviceSize GetIndiciesSize() { return sizeof(indices[0]) * indices.size(); }
-	std::vector<VulkanTools::VertexInput> GetVertices() { return vertices; }
-	std::vector<uint16_t> GetIndicies() { return indices; }
+	const std::vector<VulkanTools::VertexInput>& GetVertices() const { return vertices; }
+	const std::vector<uint16_t>& GetIndicies() const { return indices; }
+	const std::vector<Lod>& GetLods() const { return lods; }
+	const std::vector<CacheStats>& GetCacheStats() const { return cacheStats; }
+	const Lod& GetImpostorQuad() const { return impostorQuad; }
 };
 #endif
@@ -0,0 +1,176 @@
+#include "TrajectoryRecorder.h"
+
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace sim {
+
+	TrajectoryRecorder::TrajectoryRecorder(const std::string& path, uint32_t bodyCount) : bytesIn(0), bytesOut(0)
+	{
+		header.bodyCount = bodyCount;
+		previous.resize(bodyCount * 3, 0);
+		statsTime = std::chrono::high_resolution_clock::now();
+
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			spdlog::error("Recorder: Could not open {}", path);
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(TrajectoryHeader));
+		writer = std::thread(&TrajectoryRecorder::WriterLoop, this);
+	}
+
+	TrajectoryRecorder::~TrajectoryRecorder()
+	{
+		if (!file.is_open())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueCondition.notify_one();
+		writer.join();
+
+		//Chunk index at the end, then point the header at it
+		header.chunkCount = index.size();
+		header.indexOffset = file.tellp();
+		file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(TrajectoryIndexEntry));
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(TrajectoryHeader));
+		file.close();
+	}
+
+	void TrajectoryRecorder::Submit(uint64_t step, double simulationTime, const void* source, size_t stride, std::function<void()> release)
+	{
+		if (!file.is_open())
+		{
+			release();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back({ step, simulationTime, static_cast<const uint8_t*>(source), stride, release });
+		}
+		bytesIn += header.bodyCount * 3 * sizeof(float);
+		queueCondition.notify_one();
+	}
+
+	TrajectoryRecorder::Stats TrajectoryRecorder::GetStats()
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(now - statsTime).count();
+		statsTime = now;
+
+		Stats stats;
+		stats.inputBandwidth = bytesIn.exchange(0) / seconds / (1024.0 * 1024.0);
+		stats.outputBandwidth = bytesOut.exchange(0) / seconds / (1024.0 * 1024.0);
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stats.backlog = queue.size();
+		stats.chunks = index.size();
+		return stats;
+	}
+
+	void TrajectoryRecorder::WriterLoop()
+	{
+		while (true)
+		{
+			Snapshot snapshot;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (queue.empty())
+					return;
+				snapshot = queue.front();
+				queue.pop_front();
+			}
+			WriteChunk(snapshot);
+		}
+	}
+
+	void TrajectoryRecorder::WriteChunk(const Snapshot& snapshot)
+	{
+		TrajectoryChunkHeader chunk;
+		chunk.step = snapshot.step;
+		chunk.simulationTime = snapshot.simulationTime;
+		chunk.keyframe = index.size() % TRAJECTORY_KEYFRAME_INTERVAL == 0 ? 1 : 0;
+
+		//XOR each float's bits with the previous snapshot, slowly moving bodies leave mostly zero high bytes
+		uint32_t valueCount = header.bodyCount * 3;
+		std::vector<uint32_t> current(valueCount);
+		for (uint32_t i = 0; i < header.bodyCount; i++)
+			memcpy(&current[i * 3], snapshot.source + i * snapshot.stride, 3 * sizeof(float));
+		snapshot.release();
+
+		//Store as byte planes so the zero bytes form long runs
+		encoded.resize(valueCount * sizeof(uint32_t));
+		for (uint32_t i = 0; i < valueCount; i++)
+		{
+			uint32_t delta = chunk.keyframe ? current[i] : current[i] ^ previous[i];
+			for (uint32_t byte = 0; byte < 4; byte++)
+				encoded[byte * valueCount + i] = static_cast<uint8_t>(delta >> (byte * 8));
+		}
+		previous.swap(current);
+
+		CompressZeroRuns(encoded, compressed);
+		chunk.rawSize = encoded.size();
+		chunk.compressedSize = compressed.size();
+
+		{
+			//GetStats reads the chunk count from the render thread
+			std::lock_guard<std::mutex> lock(queueMutex);
+			index.push_back({ chunk.step, chunk.simulationTime, static_cast<uint64_t>(file.tellp()) });
+		}
+		file.write(reinterpret_cast<const char*>(&chunk), sizeof(TrajectoryChunkHeader));
+		file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+		bytesOut += sizeof(TrajectoryChunkHeader) + compressed.size();
+	}
+
+	void CompressZeroRuns(const std::vector<uint8_t>& input, std::vector<uint8_t>& output)
+	{
+		//Control byte: top bit set is a run of up to 128 zeros, otherwise up to 128 literal bytes follow
+		output.clear();
+		size_t i = 0;
+		while (i < input.size())
+		{
+			size_t run = 0;
+			while (i + run < input.size() && input[i + run] == 0 && run < 128)
+				run++;
+			if (run >= 2)
+			{
+				output.push_back(static_cast<uint8_t>(0x80 | (run - 1)));
+				i += run;
+				continue;
+			}
+
+			size_t literal = 0;
+			while (i + literal < input.size() && literal < 128 && !(input[i + literal] == 0 && i + literal + 1 < input.size() && input[i + literal + 1] == 0))
+				literal++;
+			if (literal == 0)
+				literal = 1;
+			output.push_back(static_cast<uint8_t>(literal - 1));
+			output.insert(output.end(), input.begin() + i, input.begin() + i + literal);
+			i += literal;
+		}
+	}
+
+	void DecompressZeroRuns(const uint8_t* input, size_t size, std::vector<uint8_t>& output)
+	{
+		output.clear();
+		size_t i = 0;
+		while (i < size)
+		{
+			uint8_t control = input[i++];
+			size_t count = (control & 0x7F) + 1;
+			if (control & 0x80)
+				output.insert(output.end(), count, 0);
+			else
+			{
+				output.insert(output.end(), input + i, input + i + count);
+				i += count;
+			}
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef TRAJECTORYRECORDER_H
+#define TRAJECTORYRECORDER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "Simulation.h"
+
+namespace sim {
+	const uint32_t TRAJECTORY_VERSION = 1;
+	const uint32_t TRAJECTORY_KEYFRAME_INTERVAL = 64; //Chunks between snapshots that are not delta encoded
+
+	//File layout: header, chunks appended as they are recorded, then a chunk index written on close and pointed to by the header
+	struct TrajectoryHeader {
+		char magic[4] = { 'O', 'R', 'V', 'T' };
+		uint32_t version = TRAJECTORY_VERSION;
+		uint32_t bodyCount = 0;
+		uint32_t chunkCount = 0;
+		uint64_t indexOffset = 0; //0 if the recording was not closed cleanly, chunks can still be walked one by one
+	};
+
+	struct TrajectoryChunkHeader {
+		uint64_t step = 0;
+		double simulationTime = 0.0;
+		uint32_t keyframe = 0; //1 if the positions are stored as is, otherwise XORed with the previous chunk
+		uint32_t rawSize = 0;
+		uint32_t compressedSize = 0;
+		uint32_t padding = 0;
+	};
+
+	struct TrajectoryIndexEntry {
+		uint64_t step;
+		double simulationTime;
+		uint64_t offset;
+	};
+
+	//Delta encodes and compresses position snapshots into an append only file on its own thread
+	class TrajectoryRecorder
+	{
+	private:
+		struct Snapshot {
+			uint64_t step;
+			double simulationTime;
+			const uint8_t* source;
+			size_t stride;
+			std::function<void()> release;
+		};
+
+		std::ofstream file;
+		TrajectoryHeader header;
+		std::vector<TrajectoryIndexEntry> index;
+		std::vector<uint32_t> previous;
+		std::vector<uint8_t> encoded;
+		std::vector<uint8_t> compressed;
+
+		std::thread writer;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::deque<Snapshot> queue;
+		bool stopping = false;
+
+		std::atomic<uint64_t> bytesIn;
+		std::atomic<uint64_t> bytesOut;
+		std::chrono::high_resolution_clock::time_point statsTime;
+
+		void WriterLoop();
+		void WriteChunk(const Snapshot& snapshot);
+
+	public:
+		struct Stats {
+			double inputBandwidth; //MB/s of positions handed to the writer
+			double outputBandwidth; //MB/s written to disk
+			size_t backlog; //Snapshots waiting to be written
+			uint32_t chunks;
+		};
+
+		TrajectoryRecorder(const std::string& path, uint32_t bodyCount);
+		~TrajectoryRecorder();
+
+		bool IsOpen() { return file.is_open(); }
+
+		//Queues bodyCount positions read from source with the given stride, release is called from the writer thread once source is no longer needed
+		void Submit(uint64_t step, double simulationTime, const void* source, size_t stride, std::function<void()> release);
+		//Bandwidth is averaged since the previous call
+		Stats GetStats();
+	};
+
+	//Zero run length encoding, the XORed byte planes are mostly zeros
+	void CompressZeroRuns(const std::vector<uint8_t>& input, std::vector<uint8_t>& output);
+	void DecompressZeroRuns(const uint8_t* input, size_t size, std::vector<uint8_t>& output);
+}
+#endif
@@ -75,6 +75,9 @@ namespace VulkanTools {
 #endif
 #ifdef VK_EXT_descriptor_indexing
 			addExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+#endif
+#ifdef VK_KHR_shader_atomic_int64
+			addExtension(VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME);
 #endif
 		}
 	};
@@ -110,11 +113,10 @@ namespace VulkanTools {
 		}
 	};
 
-	struct VertexInput
+	struct VertexInput //12 bytes, see SolidSphere::GetVertexAttributeDescription
 	{
-		glm::vec3 pos;
-		glm::vec4 colour;
-		glm::vec3 uv;
+		int16_t pos[4]; //Snorm, w unused
+		uint16_t uv[2]; //Halves, u runs past 1 on triangles that cross the seam
 	};
 }
 #endif
\ No newline at end of file
@@ -22,8 +22,7 @@ void Vulkan::InitVulkan(GLFWwindow* window)
 	CreateSurface(window);
 	CreateDevice();
 	CreateSwapchain();
-	CreateRenderpass();
-	CreateFramebuffers();
+	CreateRenderTargets();
 	CreateCommandPool();
 	CreateFencesAndSemaphores();
 }
@@ -38,13 +37,12 @@ void Vulkan::Cleanup()
 		m_vulkanResources->device.destroySemaphore(m_vulkanResources->semaphoreRender[i]);
 	}
 
+	m_vulkanResources->commandRecorder.Destroy();
 	m_vulkanResources->commandPool.Destroy();
 	m_vulkanResources->commandPoolTransfer.Destroy();
 	m_vulkanResources->device.destroyDescriptorPool(m_vulkanResources->descriptorPool);
 	
-	for (auto& framebuffer : m_vulkanResources->frameBuffers)
-		m_vulkanResources->device.destroyFramebuffer(framebuffer);
-	m_vulkanResources->device.destroyRenderPass(m_vulkanResources->renderpass);
+	DestroyRenderTargets();
 	m_vulkanResources->swapchain.Destroy();
 	m_vulkanResources->device.destroy();
 	m_vulkanResources->instance.destroySurfaceKHR(m_vulkanResources->surface);
@@ -173,7 +171,8 @@ void Vulkan::CreateInstance(VulkanTools::InstanceExtenstions extensionsRequested
 				if (maxSamples & vk::SampleCountFlagBits::e2) { return vk::SampleCountFlagBits::e2; }
 				return vk::SampleCountFlagBits::e1;
 			};
-			m_msaaSamples = getSampleCount();
+			m_maxMsaaSamples = getSampleCount();
+			m_msaaSamples = m_multisample ? m_maxMsaaSamples : vk::SampleCountFlagBits::e1;
 			break;
 		}
 	}
@@ -361,6 +360,41 @@ void Vulkan::CreateDevice(VulkanTools::DeviceExtensions extensionsRequested)
 	for (const auto& extension : enabledExtensions)
 		spdlog::info("\t{}", extension);
 
+	//Only chain the 64 bit atomic features when the extension is there to enable them
+	vk::PhysicalDeviceShaderAtomicInt64Features atomicInt64Features = {};
+	for (const auto& extension : enabledExtensions)
+	{
+		if (!strcmp(extension, VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME))
+		{
+			vk::PhysicalDeviceFeatures2 atomicFeatures2;
+			atomicFeatures2.setPNext(&atomicInt64Features);
+			m_vulkanResources->physicalDevice.getFeatures2(&atomicFeatures2);
+			indexingFeatures.setPNext(&atomicInt64Features);
+		}
+	}
+	//The splat shader also declares uint64_t values, which needs the core 64 bit integer feature. getFeatures left it enabled if the device has it
+	m_bufferInt64Atomics = atomicInt64Features.shaderBufferInt64Atomics && features.shaderInt64;
+	spdlog::info("Vulkan: 64 bit buffer atomics {}, 64 bit shader integers {}", atomicInt64Features.shaderBufferInt64Atomics ? "supported" : "not supported",
+		features.shaderInt64 ? "supported" : "not supported");
+
+	//Multiview is core in 1.1 and always enabled, the vertex shaders read gl_ViewIndex even with a single view
+	vk::PhysicalDeviceMultiviewFeatures multiviewFeatures = {};
+	vk::PhysicalDeviceFeatures2 multiviewFeatures2;
+	multiviewFeatures2.setPNext(&multiviewFeatures);
+	m_vulkanResources->physicalDevice.getFeatures2(&multiviewFeatures2);
+	multiviewFeatures.setPNext(indexingFeatures.pNext);
+	indexingFeatures.setPNext(&multiviewFeatures);
+
+	vk::PhysicalDeviceMultiviewProperties multiviewProperties = {};
+	vk::PhysicalDeviceProperties2 properties2;
+	properties2.pNext = &multiviewProperties;
+	m_vulkanResources->physicalDevice.getProperties2(&properties2);
+	if (m_viewCount > 1 && (!multiviewFeatures.multiview || m_viewCount > multiviewProperties.maxMultiviewViewCount))
+	{
+		spdlog::warn("Vulkan: {} views asked for, the device draws at most {} in a pass. Drawing one", m_viewCount, multiviewFeatures.multiview ? multiviewProperties.maxMultiviewViewCount : 1);
+		m_viewCount = 1;
+	}
+
 	m_vulkanResources->device = m_vulkanResources->physicalDevice.createDevice(deviceInfo);
 
 	m_vulkanResources->queueGraphics = m_vulkanResources->device.getQueue(m_queueIDs.graphics.familyID, m_queueIDs.graphics.queueID);
@@ -397,6 +431,9 @@ void Vulkan::CreateSwapchain()
 
 	if (surfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc)
 		swapchainImageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+	//Post passes blit their result in
+	if (surfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst)
+		swapchainImageUsage |= vk::ImageUsageFlagBits::eTransferDst;
 	
 	swapchainCreateInfo.imageUsage = swapchainImageUsage;
 	swapchainCreateInfo.imageExtent = surfaceCapabilities.maxImageExtent;
@@ -453,22 +490,70 @@ void Vulkan::CreateSwapchain()
 	swapchainCreateInfo.surface = m_vulkanResources->surface;
 
 	m_vulkanResources->swapchain = vko::VulkanSwapchain(m_vulkanResources->instance, m_vulkanResources->device, m_vulkanResources->physicalDevice, swapchainCreateInfo);
-	vk::DeviceMemory depthImageMemory;
-	vko::Image depthImage = CreateImage(vk::ImageType::e2D, vk::Format::eD32Sfloat,
-		vk::Extent3D(swapchainCreateInfo.imageExtent, 1), vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth,
-		vk::ImageCreateFlagBits(0), m_msaaSamples, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	m_vulkanResources->swapchain.SetDepthImage(VulkanTools::ImageResources(depthImage.image, depthImage.imageView, depthImage.memory));
-
-	vko::Image multiSampleImage = CreateImage(vk::ImageType::e2D, formatToUse,
-		vk::Extent3D(swapchainCreateInfo.imageExtent, 1), vk::ImageUsageFlagBits::eColorAttachment, vk::ImageAspectFlagBits::eColor,
-		vk::ImageCreateFlagBits(0), m_msaaSamples, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	m_vulkanResources->swapchain.SetMultiSampleImage(VulkanTools::ImageResources(multiSampleImage.image, multiSampleImage.imageView, multiSampleImage.memory));
+	//Each view is drawn at its share of the width
+	m_renderExtent = m_vulkanResources->swapchain.GetDimensions();
+	m_renderExtent.width = std::max(m_renderExtent.width / m_viewCount, 1u);
 	spdlog::info("Created Swapchain");
 }
 
+void Vulkan::CreateRenderTargets()
+{
+	vk::Extent3D extent = vk::Extent3D(m_renderExtent, 1);
+
+	//Views are layers of the offscreen target, the post pass tiles them across the swapchain image
+	if (m_viewCount > 1)
+		m_postProcess = true;
+
+	//Targets are only ever attached or read through samplers of their own, the one CreateImage makes is dropped
+	auto keepTarget = [this](vko::Image target) {
+		m_vulkanResources->device.destroySampler(target.sampler);
+		return VulkanTools::ImageResources(target.image, target.imageView, target.memory);
+	};
+
+	vko::Image depthImage = CreateImage(vk::ImageType::e2D, vk::Format::eD32Sfloat,
+		extent, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eDepth,
+		vk::ImageCreateFlagBits(0), m_msaaSamples, vk::MemoryPropertyFlagBits::eDeviceLocal, 1, m_viewCount);
+	m_vulkanResources->swapchain.SetDepthImage(keepTarget(depthImage));
+
+	if (m_msaaSamples != vk::SampleCountFlagBits::e1)
+	{
+		vko::Image multiSampleImage = CreateImage(vk::ImageType::e2D, GetRenderTargetFormat(),
+			extent, vk::ImageUsageFlagBits::eColorAttachment, vk::ImageAspectFlagBits::eColor,
+			vk::ImageCreateFlagBits(0), m_msaaSamples, vk::MemoryPropertyFlagBits::eDeviceLocal, 1, m_viewCount);
+		m_vulkanResources->swapchain.SetMultiSampleImage(keepTarget(multiSampleImage));
+	}
+
+	if (m_postProcess)
+	{
+		vko::Image colourImage = CreateImage(vk::ImageType::e2D, GetRenderTargetFormat(),
+			extent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc, vk::ImageAspectFlagBits::eColor,
+			vk::ImageCreateFlagBits(0), vk::SampleCountFlagBits::e1, vk::MemoryPropertyFlagBits::eDeviceLocal, 1, m_viewCount);
+		m_vulkanResources->swapchain.SetColourImage(keepTarget(colourImage));
+	}
+
+	CreateRenderpass();
+	CreateFramebuffers();
+}
+
+void Vulkan::DestroyRenderTargets()
+{
+	for (auto& framebuffer : m_vulkanResources->frameBuffers)
+		m_vulkanResources->device.destroyFramebuffer(framebuffer);
+	m_vulkanResources->frameBuffers.clear();
+	m_vulkanResources->device.destroyRenderPass(m_vulkanResources->renderpass);
+	m_vulkanResources->device.destroyRenderPass(m_vulkanResources->renderpassLoad);
+	m_vulkanResources->swapchain.DestroyRenderTargets();
+}
+
+vk::Format Vulkan::GetRenderTargetFormat()
+{
+	//Post passes read and write it in compute, where the swapchain's sRGB format cannot be stored to
+	return m_postProcess ? vk::Format::eR16G16B16A16Sfloat : m_vulkanResources->swapchain.GetSwapchainFormat();
+}
+
 void Vulkan::CreateRenderpass()
 {
-	vk::AttachmentDescription colourAttachDesc = vk::AttachmentDescription({}, m_vulkanResources->swapchain.GetSwapchainFormat());
+	vk::AttachmentDescription colourAttachDesc = vk::AttachmentDescription({}, GetRenderTargetFormat());
 	colourAttachDesc.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 	colourAttachDesc.loadOp = vk::AttachmentLoadOp::eClear;
 	colourAttachDesc.storeOp = vk::AttachmentStoreOp::eStore;
@@ -479,13 +564,15 @@ void Vulkan::CreateRenderpass()
 	vk::AttachmentDescription depthAttachDesc = vk::AttachmentDescription({}, vk::Format::eD32Sfloat);
 	depthAttachDesc.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 	depthAttachDesc.loadOp = vk::AttachmentLoadOp::eClear;
-	depthAttachDesc.storeOp = vk::AttachmentStoreOp::eDontCare;
+	depthAttachDesc.storeOp = vk::AttachmentStoreOp::eStore; //Read back to build the occlusion pyramid
 	depthAttachDesc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 	depthAttachDesc.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 	depthAttachDesc.samples = m_msaaSamples;
 
-	vk::AttachmentDescription colourAttachResolveDesc = vk::AttachmentDescription({}, m_vulkanResources->swapchain.GetSwapchainFormat());
-	colourAttachResolveDesc.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+	//Post processed frames are left in the offscreen target for the post pass, it presents
+	vk::ImageLayout presentLayout = m_postProcess ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::ePresentSrcKHR;
+	vk::AttachmentDescription colourAttachResolveDesc = vk::AttachmentDescription({}, GetRenderTargetFormat());
+	colourAttachResolveDesc.finalLayout = presentLayout;
 	colourAttachResolveDesc.loadOp = vk::AttachmentLoadOp::eDontCare;
 	colourAttachResolveDesc.storeOp = vk::AttachmentStoreOp::eStore;
 	colourAttachResolveDesc.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
@@ -500,7 +587,12 @@ void Vulkan::CreateRenderpass()
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colourAttachRef;
 	subpass.pDepthStencilAttachment = &depthAttachRef;
-	subpass.pResolveAttachments = &colourAttachResolveRef;
+
+	//Single sampled the swapchain image is drawn to directly, it is left for the second pass to present.
+	//Multisampled the first pass leaves the resolve attachment alone and only the second resolves, once everything is drawn.
+	//Render passes with a single subpass stay compatible whatever their resolve attachments, so both share the framebuffers
+	bool resolve = m_msaaSamples != vk::SampleCountFlagBits::e1;
+	colourAttachResolveDesc.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
 	vk::SubpassDependency dependency = vk::SubpassDependency();
 	dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
@@ -508,10 +600,35 @@ void Vulkan::CreateRenderpass()
 	dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
 
 	std::vector<vk::AttachmentDescription> attachments = { colourAttachDesc, depthAttachDesc, colourAttachResolveDesc };
+	if (!resolve)
+		attachments.pop_back();
 	vk::RenderPassCreateInfo createInfo = vk::RenderPassCreateInfo({}, attachments.size(), attachments.data(), 1, &subpass, 1, &dependency);
 
+	//With more than one view every draw is broadcast to each layer, gl_ViewIndex picks the view's matrices
+	uint32_t viewMask = (1u << m_viewCount) - 1u;
+	vk::RenderPassMultiviewCreateInfo multiviewInfo = vk::RenderPassMultiviewCreateInfo(1, &viewMask, 0, nullptr, 1, &viewMask);
+	if (m_viewCount > 1)
+		createInfo.setPNext(&multiviewInfo);
+
 	m_vulkanResources->renderpass = m_vulkanResources->device.createRenderPass(createInfo);
 
+	//Second pass of the frame, after the occlusion pyramid is built. Loads the colour and depth the first left and resolves
+	if (resolve)
+	{
+		subpass.pResolveAttachments = &colourAttachResolveRef;
+		attachments[2].finalLayout = presentLayout;
+	}
+	attachments[0].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[0].initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+	attachments[1].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[1].storeOp = m_postProcess ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare; //Temporal AA reprojects with it
+	attachments[1].initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+	if (!resolve)
+		attachments[0].finalLayout = presentLayout;
+
+	dependency.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+	m_vulkanResources->renderpassLoad = m_vulkanResources->device.createRenderPass(createInfo);
+
 	spdlog::info("Created RenderPass");
 
 }
@@ -519,14 +636,15 @@ void Vulkan::CreateRenderpass()
 void Vulkan::CreateFramebuffers()
 {
 	vk::FramebufferCreateInfo createInfo = vk::FramebufferCreateInfo({}, m_vulkanResources->renderpass);
-	vk::Extent2D dimensions = m_vulkanResources->swapchain.GetDimensions();
-	createInfo.width = dimensions.width;
-	createInfo.height = dimensions.height;
+	createInfo.width = m_renderExtent.width;
+	createInfo.height = m_renderExtent.height;
 	createInfo.layers = 1;
 	for (size_t i = 0; i < m_vulkanResources->swapchain.GetImageCount(); i++)
 	{
-		VulkanTools::ImageResources image = m_vulkanResources->swapchain.GetImages()[i];
+		VulkanTools::ImageResources image = m_postProcess ? m_vulkanResources->swapchain.GetColourImage() : m_vulkanResources->swapchain.GetImages()[i];
 		std::vector<vk::ImageView> attachments = { m_vulkanResources->swapchain.GetMultiSampleImage().imageView, m_vulkanResources->swapchain.GetDepthImage().imageView, image.imageView  };
+		if (m_msaaSamples == vk::SampleCountFlagBits::e1)
+			attachments = { image.imageView, m_vulkanResources->swapchain.GetDepthImage().imageView };
 		createInfo.attachmentCount = attachments.size();
 		createInfo.pAttachments = attachments.data();
 
@@ -557,6 +675,9 @@ void Vulkan::CreateCommandPool()
 	else
 		m_vulkanResources->commandPoolTransfer = vko::VulkanCommandPool(m_vulkanResources->device, m_queueIDs.transfer.familyID, vk::CommandPoolCreateFlagBits::eTransient);
 
+	//Recording threads each get a pool per swapchain image
+	m_vulkanResources->commandRecorder.Create(m_vulkanResources->device, m_queueIDs.graphics.familyID, m_vulkanResources->swapchain.GetImageCount(), m_recordThreads);
+
 	spdlog::info("Created CommandPool");
 }
 
@@ -605,6 +726,20 @@ uint32_t Vulkan::GetMemoryTypeIndex(uint32_t typeFilter, vk::MemoryPropertyFlags
 	}
 }
 
+//Host cached memory is much faster for the CPU to read from, fall back to plain host visible memory where there is none
+vk::MemoryPropertyFlags Vulkan::GetReadbackMemoryFlags()
+{
+	vk::PhysicalDeviceMemoryProperties memProps = m_vulkanResources->physicalDevice.getMemoryProperties();
+	vk::MemoryPropertyFlags cached = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached;
+
+	for (size_t i = 0; i < memProps.memoryTypeCount; i++)
+	{
+		if ((memProps.memoryTypes[i].propertyFlags & cached) == cached)
+			return cached;
+	}
+	return vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+}
+
 vko::Image Vulkan::CreateImage(vk::ImageType imageType, vk::Format format, vk::Extent3D extent,
 	vk::ImageUsageFlags usage, vk::ImageAspectFlagBits aspectFlags, vk::ImageCreateFlags flags, vk::SampleCountFlagBits samples,
 	vk::MemoryPropertyFlags memoryFlags, int mipLevels, int layerCount, vk::SharingMode sharingMode,
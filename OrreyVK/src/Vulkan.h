@@ -19,6 +19,7 @@
 
 #include "VulkanSwapchain.h"
 #include "VulkanCommandPool.h"
+#include "VulkanCommandRecorder.h"
 #include "VulkanBuffer.h"
 #include "VulkanImage.h"
 #include "Types.h"
@@ -46,9 +47,10 @@ protected:
 		vk::Queue queueTransfer;
 
 		vk::RenderPass renderpass;
+		vk::RenderPass renderpassLoad; //Same attachments as renderpass, carries on from what it left
 		std::vector<vk::Framebuffer> frameBuffers;
 		vko::VulkanCommandPool commandPool;
-		std::vector<vk::CommandBuffer> commandBuffers;
+		vko::VulkanCommandRecorder commandRecorder; //Each frame's passes, recorded again every time it is drawn
 		
 		vko::VulkanCommandPool commandPoolTransfer;
 
@@ -64,15 +66,26 @@ protected:
 	VulkanTools::QueueFamilies m_queueIDs;
 	uint32_t m_frameID = 0;
 	vk::SampleCountFlagBits m_msaaSamples;
+	vk::SampleCountFlagBits m_maxMsaaSamples = vk::SampleCountFlagBits::e1; //Most the device supports for colour and depth, what MSAA renders with
+	bool m_multisample = true; //Cleared before InitVulkan to render single sampled straight into the swapchain images
+	bool m_postProcess = false; //Render into an offscreen colour target instead of the swapchain images, for a post pass to write them from
+	vk::Extent2D m_renderExtent; //Size the scene is drawn at, the swapchain's unless it is scaled down and post processed up to it
+	bool m_bufferInt64Atomics = false; //64 bit integers and atomics on storage buffers, for splatting sub-pixel objects
+	uint32_t m_recordThreads = 1; //Threads a frame's passes are recorded on, the calling one included. Set before InitVulkan
+	uint32_t m_viewCount = 1; //Views drawn at once with multiview, each a layer of every render target and a tile of the swapchain image. Set before InitVulkan
 
 	uint32_t GetMemoryTypeIndex(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+	vk::MemoryPropertyFlags GetReadbackMemoryFlags();
 
 	void CreateInstance(VulkanTools::InstanceExtenstions extensionsRequested = VulkanTools::InstanceExtenstions());
 	void CreateSurface(GLFWwindow* window);
 	void CreateDevice(VulkanTools::DeviceExtensions extensionsRequested = VulkanTools::DeviceExtensions());
 	void CreateSwapchain();
+	void CreateRenderTargets();
+	void DestroyRenderTargets();
 	void CreateRenderpass();
 	void CreateFramebuffers();
+	vk::Format GetRenderTargetFormat();
 	void CreateDebugging();
 
 	void CreateCommandPool();
@@ -47,6 +47,8 @@ namespace vko {
 
 		void Destroy()
 		{
+			if (!device)
+				return;
 			UnMap();
 			device.destroyBuffer(buffer);
 			device.freeMemory(memory);
@@ -1,14 +1,14 @@
 #include "VulkanCommandPool.h"
 namespace vko {
 
-	vk::CommandBuffer VulkanCommandPool::AllocateCommandBuffer()
+	vk::CommandBuffer VulkanCommandPool::AllocateCommandBuffer(vk::CommandBufferLevel level)
 	{
-		return AllocateCommandBuffers(1)[0];
+		return AllocateCommandBuffers(1, level)[0];
 	}
 
-	std::vector<vk::CommandBuffer> VulkanCommandPool::AllocateCommandBuffers(uint32_t count)
+	std::vector<vk::CommandBuffer> VulkanCommandPool::AllocateCommandBuffers(uint32_t count, vk::CommandBufferLevel level)
 	{
-		vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo(commandPool);
+		vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo(commandPool, level);
 		allocInfo.commandBufferCount = count;
 
 		std::vector<vk::CommandBuffer> commandBuffers = device.allocateCommandBuffers(allocInfo);
@@ -20,6 +20,21 @@ namespace vko {
 		device.freeCommandBuffers(commandPool, commandBuffers);
 	}
 
+	vk::CommandBuffer VulkanCommandPool::NextCommandBuffer(vk::CommandBufferLevel level)
+	{
+		uint32_t kind = level == vk::CommandBufferLevel::ePrimary ? 0 : 1;
+		if (recycledUsed[kind] == recycled[kind].size())
+			recycled[kind].push_back(AllocateCommandBuffer(level));
+		return recycled[kind][recycledUsed[kind]++];
+	}
+
+	void VulkanCommandPool::Reset()
+	{
+		device.resetCommandPool(commandPool, {});
+		recycledUsed[0] = 0;
+		recycledUsed[1] = 0;
+	}
+
 	void VulkanCommandPool::Destroy()
 	{
 		device.destroyCommandPool(commandPool);
@@ -10,6 +10,9 @@ namespace vko {
 	private:
 		vk::CommandPool commandPool;
 		vk::Device device;
+		//Handed out again by NextCommandBuffer after each Reset, primary then secondary
+		std::vector<vk::CommandBuffer> recycled[2];
+		uint32_t recycledUsed[2] = { 0, 0 };
 
 	public:
 		VulkanCommandPool() {};
@@ -20,9 +23,13 @@ namespace vko {
 			commandPool = device.createCommandPool(commandPoolInfo);
 		}
 
-		vk::CommandBuffer AllocateCommandBuffer();
-		std::vector<vk::CommandBuffer> AllocateCommandBuffers(uint32_t count);
+		vk::CommandBuffer AllocateCommandBuffer(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+		std::vector<vk::CommandBuffer> AllocateCommandBuffers(uint32_t count, vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 		void FreeCommandBuffers(vk::ArrayProxy<const vk::CommandBuffer> commandBuffers);
+		//For pools reset as a whole rather than freeing their buffers. Allocates only when more are used between resets than ever before
+		vk::CommandBuffer NextCommandBuffer(vk::CommandBufferLevel level);
+		//Every buffer allocated from the pool goes back to the initial state, the GPU must be done with all of them
+		void Reset();
 		void Destroy();
 	};
 }
@@ -0,0 +1,111 @@
+#include "VulkanCommandRecorder.h"
+namespace vko {
+
+	void VulkanCommandRecorder::Create(vk::Device device, uint32_t queueFamily, uint32_t frameCount, uint32_t threadCount)
+	{
+		this->device = device;
+		pools.resize(frameCount);
+		for (std::vector<VulkanCommandPool>& framePools : pools)
+			for (uint32_t thread = 0; thread < threadCount; thread++)
+				framePools.push_back(VulkanCommandPool(device, queueFamily, vk::CommandPoolCreateFlagBits::eTransient));
+
+		for (uint32_t thread = 1; thread < threadCount; thread++)
+			workers.push_back(std::thread(&VulkanCommandRecorder::WorkerLoop, this, thread));
+	}
+
+	vk::CommandBuffer VulkanCommandRecorder::RecordFrame(uint32_t frame, const std::vector<Pass>& passes)
+	{
+		for (VulkanCommandPool& pool : pools[frame])
+			pool.Reset();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->frame = frame;
+			this->passes = &passes;
+			recorded.assign(passes.size(), vk::CommandBuffer());
+			nextPass = 0;
+			busy = workers.size();
+			generation++;
+		}
+		startCondition.notify_all();
+		RecordPasses(0);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			doneCondition.wait(lock, [this] { return busy == 0; });
+		}
+
+		//Passes sharing a render pass are executed together inside it
+		vk::CommandBuffer cmdBuffer = pools[frame][0].NextCommandBuffer(vk::CommandBufferLevel::ePrimary);
+		cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			bool inRenderPass = static_cast<bool>(passes[i].begin.renderPass);
+			if (inRenderPass && !passes[i].continues)
+				cmdBuffer.beginRenderPass(passes[i].begin, vk::SubpassContents::eSecondaryCommandBuffers);
+			cmdBuffer.executeCommands(recorded[i]);
+			if (inRenderPass && (i + 1 == passes.size() || !passes[i + 1].continues))
+				cmdBuffer.endRenderPass();
+		}
+		cmdBuffer.end();
+		return cmdBuffer;
+	}
+
+	void VulkanCommandRecorder::WorkerLoop(uint32_t thread)
+	{
+		uint64_t started = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				startCondition.wait(lock, [&] { return stopping || generation != started; });
+				if (stopping)
+					return;
+				started = generation;
+			}
+
+			RecordPasses(thread);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busy--;
+			}
+			doneCondition.notify_one();
+		}
+	}
+
+	void VulkanCommandRecorder::RecordPasses(uint32_t thread)
+	{
+		VulkanCommandPool& pool = pools[frame][thread];
+		for (uint32_t pass = nextPass++; pass < passes->size(); pass = nextPass++)
+		{
+			const Pass& info = (*passes)[pass];
+			vk::CommandBufferInheritanceInfo inheritance = vk::CommandBufferInheritanceInfo(info.begin.renderPass, 0, info.begin.framebuffer);
+			vk::CommandBufferUsageFlags usage = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+			if (info.begin.renderPass)
+				usage |= vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+
+			vk::CommandBuffer cmdBuffer = pool.NextCommandBuffer(vk::CommandBufferLevel::eSecondary);
+			cmdBuffer.begin(vk::CommandBufferBeginInfo(usage, &inheritance));
+			info.record(cmdBuffer);
+			cmdBuffer.end();
+			recorded[pass] = cmdBuffer;
+		}
+	}
+
+	void VulkanCommandRecorder::Destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		startCondition.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+
+		for (std::vector<VulkanCommandPool>& framePools : pools)
+			for (VulkanCommandPool& pool : framePools)
+				pool.Destroy();
+		pools.clear();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef VULKANCOMMANDRECORDER_H
+#define VULKANCOMMANDRECORDER_H
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vulkan/vulkan.hpp>
+#include "VulkanCommandPool.h"
+
+namespace vko {
+	//Records a frame's passes into secondary command buffers on several threads, then stitches them into one primary in order.
+	//Every thread has a pool per frame in flight, reset when that frame comes round again rather than freeing its buffers
+	class VulkanCommandRecorder
+	{
+	public:
+		struct Pass {
+			std::function<void(vk::CommandBuffer)> record;
+			vk::RenderPassBeginInfo begin; //No render pass for passes recorded outside one
+			bool continues = false; //Carries on the render pass of the pass before it, begin must name the same one
+		};
+
+	private:
+		vk::Device device;
+		std::vector<std::vector<VulkanCommandPool>> pools; //Frame, then thread. The thread calling RecordFrame is the first
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable startCondition;
+		std::condition_variable doneCondition;
+		uint64_t generation = 0;
+		uint32_t busy = 0;
+		bool stopping = false;
+
+		//The frame being recorded, the workers only touch it between startCondition and doneCondition
+		uint32_t frame = 0;
+		const std::vector<Pass>* passes = nullptr;
+		std::vector<vk::CommandBuffer> recorded;
+		std::atomic<uint32_t> nextPass;
+
+		void WorkerLoop(uint32_t thread);
+		void RecordPasses(uint32_t thread);
+
+	public:
+		VulkanCommandRecorder() : nextPass(0) {};
+
+		void Create(vk::Device device, uint32_t queueFamily, uint32_t frameCount, uint32_t threadCount);
+		//Passes are taken by whichever thread is free next, so none of them may depend on state another one sets.
+		//The GPU must be done with what this frame recorded last time
+		vk::CommandBuffer RecordFrame(uint32_t frame, const std::vector<Pass>& passes);
+		uint32_t GetThreadCount() { return workers.size() + 1; }
+		void Destroy();
+	};
+}
+#endif
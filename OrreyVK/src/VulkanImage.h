@@ -33,9 +33,9 @@ namespace vko {
 			samplerCreateInfo.magFilter = vk::Filter::eLinear;
 			samplerCreateInfo.minFilter = vk::Filter::eLinear;
 			samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-			samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
-			samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
-			samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+			samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eRepeat; //Textures wrap around in longitude, sphere triangles across the seam run u past 1
+			samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+			samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeV;
 			samplerCreateInfo.mipLodBias = 0.0f;
 			samplerCreateInfo.maxAnisotropy = 1.0f;
 			samplerCreateInfo.anisotropyEnable = false;
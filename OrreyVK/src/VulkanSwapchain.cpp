@@ -6,16 +6,20 @@ namespace vko {
 		return swapchainImages;
 	}
 
-	void VulkanSwapchain::Destroy()
+	void VulkanSwapchain::DestroyRenderTargets()
 	{
+		for (VulkanTools::ImageResources* target : { &depthImage, &multiSampleImage, &colourImage })
+		{
+			device.destroyImageView(target->imageView);
+			device.destroyImage(target->image);
+			device.freeMemory(target->memory);
+			*target = VulkanTools::ImageResources();
+		}
+	}
 
-		device.destroyImageView(depthImage.imageView);
-		device.destroyImage(depthImage.image);
-		device.freeMemory(depthImage.memory);
-
-		device.destroyImageView(multiSampleImage.imageView);
-		device.destroyImage(multiSampleImage.image);
-		device.freeMemory(multiSampleImage.memory);
+	void VulkanSwapchain::Destroy()
+	{
+		DestroyRenderTargets();
 
 		for (auto& images : swapchainImages)
 		{
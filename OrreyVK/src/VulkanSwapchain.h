@@ -15,6 +15,9 @@ namespace vko {
 		std::vector<VulkanTools::ImageResources> swapchainImages;
 		VulkanTools::ImageResources depthImage;
 		VulkanTools::ImageResources multiSampleImage;
+		VulkanTools::ImageResources colourImage; //Offscreen single sampled target, only while post processing
+
+		vk::ImageUsageFlags imageUsage = {};
 
 		uint32_t numOfImages = 0;
 		vk::Format swapchainFormat = vk::Format::eUndefined;
@@ -32,6 +35,7 @@ namespace vko {
 			this->numOfImages = createInfo.minImageCount;
 			this->swapchainFormat = createInfo.imageFormat;
 			this->dimensions = createInfo.imageExtent;
+			this->imageUsage = createInfo.imageUsage;
 
 			swapchain = this->device.createSwapchainKHR(createInfo);
 
@@ -64,9 +68,13 @@ namespace vko {
 		VulkanTools::ImageResources GetDepthImage() { return depthImage; }
 		void SetMultiSampleImage(VulkanTools::ImageResources multiSampleImage) { this->multiSampleImage = multiSampleImage; }
 		VulkanTools::ImageResources GetMultiSampleImage() { return multiSampleImage; }
+		void SetColourImage(VulkanTools::ImageResources colourImage) { this->colourImage = colourImage; }
+		VulkanTools::ImageResources GetColourImage() { return colourImage; }
+		vk::ImageUsageFlags GetImageUsage() { return imageUsage; }
 		vk::Extent2D GetDimensions() { return dimensions; }
 		vk::SwapchainKHR GetVkObject() { return swapchain; }
 
+		void DestroyRenderTargets();
 		void Destroy();
 	};
 }
@@ -5,6 +5,9 @@
 #include <vector>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
+#include <sstream>
+#include <climits>
 
 #include "OrreyVk.h"
 
@@ -69,6 +72,22 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			else
 				app->m_speed -= 1.0f;
 			break;
+		case GLFW_KEY_F5:
+			app->RequestCheckpoint();
+			break;
+		case GLFW_KEY_F6:
+			app->ToggleRecording();
+			break;
+		case GLFW_KEY_F7:
+			app->CycleAntiAliasing();
+			break;
+		case GLFW_KEY_P:
+			app->TogglePreview();
+			break;
+		case GLFW_KEY_LEFT_BRACKET:
+			//Rewind 30 days, or a year with shift
+			app->Seek(app->GetSimulationTime() - (mods & GLFW_MOD_SHIFT ? 365.25 : 30.0));
+			break;
 		case GLFW_KEY_BACKSPACE:
 			app->m_speed = 1.0f;
 			break;
@@ -98,10 +117,101 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 }
 
-int main() {
+//Numeric option values, anything that is not wholly a number is reported rather than left to std::terminate
+uint32_t ParseUnsigned(const std::string& option, const std::string& value)
+{
+	size_t end = 0;
+	unsigned long parsed = 0;
+	try {
+		parsed = std::stoul(value, &end);
+	}
+	catch (const std::logic_error&) {
+		end = 0;
+	}
+	if (end == 0 || end != value.size() || value.find('-') != std::string::npos || parsed > UINT_MAX)
+		throw std::runtime_error(option + " takes a whole number, not " + value);
+	return static_cast<uint32_t>(parsed);
+}
+
+float ParseFloat(const std::string& option, const std::string& value)
+{
+	size_t end = 0;
+	float parsed = 0.0f;
+	try {
+		parsed = std::stof(value, &end);
+	}
+	catch (const std::logic_error&) {
+		end = 0;
+	}
+	if (end == 0 || end != value.size())
+		throw std::runtime_error(option + " takes a number, not " + value);
+	return parsed;
+}
+
+std::vector<uint32_t> ParseIndexList(const std::string& option, const std::string& value)
+{
+	std::vector<uint32_t> selection;
+	std::stringstream list(value);
+	std::string index;
+	while (std::getline(list, index, ','))
+		selection.push_back(ParseUnsigned(option, index));
+	return selection;
+}
+
+int main(int argc, char** argv) {
 	try {
 		app = new OrreyVk();
-		app->Run();
+		//--benchmark-workers [max workers] [steps] [astroid count] runs the CPU worker threads headless instead of the renderer
+		if (argc > 1 && !strcmp(argv[1], "--benchmark-workers"))
+		{
+			uint32_t maxWorkers = argc > 2 ? ParseUnsigned(argv[1], argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+			uint32_t steps = argc > 3 ? ParseUnsigned(argv[1], argv[3]) : 100;
+			uint32_t astroidCount = argc > 4 ? ParseUnsigned(argv[1], argv[4]) : 1000000;
+			if (maxWorkers == 0)
+				throw std::runtime_error("--benchmark-workers needs at least one worker");
+			app->RunWorkerBenchmark(maxWorkers, steps, astroidCount);
+		}
+		else
+		{
+			for (int i = 1; i + 1 < argc; i += 2)
+			{
+				//--restore <file> starts from a checkpoint saved with F5
+				if (!strcmp(argv[i], "--restore"))
+					app->RestoreCheckpoint(argv[i + 1]);
+				//--ensemble <n> simulates n perturbed copies of the scenario side by side
+				else if (!strcmp(argv[i], "--ensemble"))
+					app->SetEnsembleSize(ParseUnsigned(argv[i], argv[i + 1]));
+				//--scenario <file> loads a text scenario, or a binary one in the checkpoint format
+				else if (!strcmp(argv[i], "--scenario"))
+					app->SetScenario(argv[i + 1]);
+				//--record <i,j,k> limits F6 trajectory recording to the listed bodies
+				else if (!strcmp(argv[i], "--record"))
+					app->SetRecordingSelection(ParseIndexList(argv[i], argv[i + 1]));
+				//--preview <i,j,k> sets the bodies P previews the path of
+				else if (!strcmp(argv[i], "--preview"))
+					app->SetPreviewSelection(ParseIndexList(argv[i], argv[i + 1]));
+				//--frame-budget <ms> sets the frame time the governor holds to, 0 switches it off
+				else if (!strcmp(argv[i], "--frame-budget"))
+					app->SetFrameBudget(ParseFloat(argv[i], argv[i + 1]));
+				//--views <n> draws up to four views side by side in one multiview pass
+				else if (!strcmp(argv[i], "--views"))
+					app->SetViewCount(ParseUnsigned(argv[i], argv[i + 1]));
+				//--eye-separation <units> moves the views apart for stereo instead of turning them to tile a wall
+				else if (!strcmp(argv[i], "--eye-separation"))
+					app->SetEyeSeparation(ParseFloat(argv[i], argv[i + 1]));
+				//--pin <knob=value> holds one of the governor's knobs: scale=0.75, lod=1 or impostor=1 doublings of their pixel sizes, amplify=1 copy, substeps=1
+				else if (!strcmp(argv[i], "--pin"))
+				{
+					std::string pin = argv[i + 1];
+					size_t equals = pin.find('=');
+					if (equals == std::string::npos)
+						std::cerr << "--pin takes knob=value, not " << pin << std::endl;
+					else
+						app->PinGovernorKnob(pin.substr(0, equals), ParseFloat(argv[i], pin.substr(equals + 1)));
+				}
+			}
+			app->Run();
+		}
 		delete(app);
 	}
 	catch (const std::runtime_error& e) {